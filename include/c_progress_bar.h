@@ -8,6 +8,7 @@
 #ifndef C_PROGRESS_BAR_H
 #define C_PROGRESS_BAR_H
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -25,16 +26,185 @@
 // Number of data points to keep for timer calculations
 #define CPB_TIMER_DATA_POINTS 5
 
+// Number of slots in the downsampled rate history shown by the sparkline
+#define CPB_RATE_HISTORY_POINTS 16
+
+// Upper bound of the number of updates between two clock reads in overhead budget mode
+#define CPB_MAX_CHECK_STRIDE 65536
+
 // Progress bar default width
 #define CPB_PROGRESS_BAR_DEFAULT_WIDTH 40
 
+// Size of the buffer each frame is rendered into before being written out
+#define CPB_FRAME_BUFFER_SIZE 1024
+
+// Size of the buffer for log lines waiting for the next frame, see cpb_log
+#define CPB_LOG_BUFFER_SIZE 4096
+
+// Size of a frame with pending log lines, which also blanks out the previous bar line
+#define CPB_OUTPUT_BUFFER_SIZE (2 * CPB_FRAME_BUFFER_SIZE + CPB_LOG_BUFFER_SIZE)
+
+// Latency histogram: values below CPB_LATENCY_SUB_BUCKETS ns are exact, and every
+// power of two above is split into CPB_LATENCY_SUB_BUCKETS linear buckets (~6% error)
+#define CPB_LATENCY_SUB_BUCKETS 16
+#define CPB_LATENCY_OCTAVES 40
+#define CPB_LATENCY_BUCKETS (CPB_LATENCY_SUB_BUCKETS * (CPB_LATENCY_OCTAVES + 1))
+
+// Limits of a compiled bar format, see CPB_Config.format
+#define CPB_FORMAT_MAX_OPS 64
+#define CPB_FORMAT_LITERALS_SIZE 256
+#define CPB_FORMAT_MAX_BAR_WIDTH 160
+
+// Number of 64-bit words of a published snapshot, see cpb_snapshot
+#define CPB_SNAPSHOT_WORDS 8
+
+// Maximum number of stages of a pipeline and length of their names
+#define CPB_PIPELINE_MAX_STAGES 8
+#define CPB_PIPELINE_STAGE_NAME_SIZE 32
+
+// Maximum length of the name of a watched process source
+#define CPB_PROCESS_SOURCE_NAME_SIZE 256
+
+struct CPB_ProgressBar;
+
+typedef enum CPB_Alert
+{
+    CPB_ALERT_NONE = 0,  // No alert is active (sent when an alert clears)
+    CPB_ALERT_STALL,     // No progress for stall_timeout seconds
+    CPB_ALERT_RATE_DROP, // Recent rate stayed below the threshold for rate_drop_window
+} CPB_Alert;
+
+/**
+ * \brief Callback invoked when the active alert of a progress bar changes.
+ *
+ * It may run on the stall watchdog thread and is called with the progress bar
+ * locked, so it must not call back into the same progress bar.
+ */
+typedef void (*CPB_AlertCallback)(
+    struct CPB_ProgressBar *progress_bar,
+    CPB_Alert alert,
+    void *user_data
+);
+
+typedef enum CPB_ClockSource
+{
+    CPB_CLOCK_MONOTONIC = 0,    // CLOCK_MONOTONIC or QueryPerformanceCounter (Windows)
+    CPB_CLOCK_MONOTONIC_COARSE, // Cheapest reads, resolution of a few milliseconds
+    CPB_CLOCK_TSC,              // Calibrated rdtsc on x86-64 with an invariant TSC
+    CPB_CLOCK_USER,             // config.clock_function, e.g. a fake clock for tests
+} CPB_ClockSource;
+
+/**
+ * \brief User supplied clock returning a monotonic time in seconds.
+ */
+typedef double (*CPB_ClockFunction)(void *user_data);
+
+/**
+ * \brief One operation of a compiled bar format: a field or a span of literal text.
+ */
+typedef struct CPB_FormatOp
+{
+    uint8_t opcode;
+    uint16_t width;
+    uint16_t literal_offset;
+    uint16_t literal_length;
+} CPB_FormatOp;
+
 typedef struct CPB_Config
 {
     char *description;
     double min_refresh_time;
     double timer_remaining_time_recent_weight;
+
+    double stall_timeout;       // Seconds without progress before a stall, 0 disables
+    double rate_drop_threshold; // Fraction of the overall rate, 0 disables
+    double rate_drop_window;    // Seconds the recent rate must stay below threshold
+    CPB_AlertCallback on_alert;
+    void *alert_user_data;
+    bool show_alerts; // Mark active alerts in the progress bar
+
+    // Unavailable clock sources fall back to CPB_CLOCK_MONOTONIC
+    CPB_ClockSource clock_source;
+    CPB_ClockFunction clock_function; // Used with CPB_CLOCK_USER
+    void *clock_user_data;
+
+    // Write frames through a separate O_NONBLOCK descriptor for stdout. Frames that
+    // cannot be written yet are replaced by newer ones; the final frame always is.
+    bool nonblocking_output;
+
+    bool show_latency;           // Show p50 and p99 of cpb_record_latency durations
+    bool dump_latency_histogram; // Print the latency histogram in cpb_finish
+
+    bool show_sparkline; // Show how the rate evolved over the whole run
+
+    // Fraction of wall time the progress bar may spend on itself, e.g. 0.005.
+    // The refresh interval (never below min_refresh_time) and the number of updates
+    // between clock reads are tuned at runtime to stay within it. 0 disables.
+    double overhead_budget;
+
+    // Layout of the bar, e.g. "{desc} {bar:30} {pct} {rate} {eta}", or NULL for the
+    // built-in layout. Compiled once by cpb_init. Fields: spinner, desc, bar[:width],
+    // pct, elapsed, eta, rate, spark, p50, p99, alert, cpu, rss, read, write, sep.
+    // Text inside "{[" and "]}" is dropped when one of its fields is empty. Use "{{"
+    // and "}}" for braces.
+    const char *format;
+
+    // Show the CPU usage, resident set size and storage I/O rates of the process.
+    // They are only sampled on render ticks at least min_refresh_time apart, and
+    // only if the format shows them.
+    bool show_resources;
+
+    // Never render anything, e.g. when the progress is only read with cpb_snapshot.
+    // Refresh ticks still happen, and count as renders in CPB_Stats.
+    bool headless;
 } CPB_Config;
 
+typedef struct CPB_Stats
+{
+    int64_t updates;            // Number of cpb_update calls
+    int64_t clock_reads;        // Number of monotonic clock reads
+    int64_t suppressed_updates; // Updates skipped because of the refresh time or stride
+    int64_t renders;            // Number of frames rendered, or ticks when headless
+    int64_t render_ns_total;    // Total time spent rendering, in nanoseconds
+    int64_t render_ns_max;      // Longest single render, in nanoseconds
+    int64_t bytes_written;      // Bytes written to the output stream
+    int64_t frames_dropped;     // Frames replaced by a newer one before being written
+    int64_t log_lines;          // Lines printed through cpb_log and cpb_printf
+    int64_t log_lines_dropped;  // Lines dropped as non-blocking output fell behind
+
+    double effective_refresh_time; // Refresh interval in use, in seconds
+    int64_t check_stride;          // Number of updates per clock read
+} CPB_Stats;
+
+typedef struct CPB_Snapshot
+{
+    int64_t current;
+    int64_t total;
+    double percentage;
+    double elapsed_time;   // Seconds since cpb_start
+    double remaining_time; // Estimated seconds left, negative if unknown
+    double rate;           // Items per second, blended like the remaining time
+    double overall_rate;   // Items per second since cpb_start
+    bool is_started;
+    bool is_finished;
+} CPB_Snapshot;
+
+typedef enum CPB_ProcessCounter
+{
+    CPB_PROCESS_FD_POSITION = 0, // Offset of a file descriptor against the file size
+    CPB_PROCESS_READ_BYTES,      // rchar from /proc/<pid>/io
+    CPB_PROCESS_WRITE_BYTES,     // wchar from /proc/<pid>/io
+} CPB_ProcessCounter;
+
+typedef struct CPB_ProcessSource
+{
+    int pid;
+    int fd;
+    CPB_ProcessCounter counter;
+    int64_t total; // Size of the watched file, 0 if unknown
+    char name[CPB_PROCESS_SOURCE_NAME_SIZE];
+} CPB_ProcessSource;
+
 typedef struct CPB_ProgressBar
 {
     int64_t start;
@@ -50,16 +220,135 @@ typedef struct CPB_ProgressBar
     {
         int64_t updates_count;
         double time_start;
+        bool _is_aborted; // Finished by cpb_abort, so the last position is kept
         double timer_time_last_update;
         double timer_percentage_last_update;
+        double timer_percentage_start;
         double timer_time_diffs[CPB_TIMER_DATA_POINTS];
         double timer_percentage_diffs[CPB_TIMER_DATA_POINTS];
 
-        // For monotonic time calculation on Windows
+        // Completed and total work in items, for totals growing with cpb_add_total
+        int64_t timer_current_start;
+        int64_t timer_total_start;
+        int64_t timer_current_last_update;
+        int64_t timer_total_last_update;
+        double timer_current_diffs[CPB_TIMER_DATA_POINTS];
+        double timer_total_diffs[CPB_TIMER_DATA_POINTS];
+
+        // Items per second of the bottleneck stage if the bar is part of a pipeline
+        double bottleneck_rate;
+
+        // Seqlock-protected copy of the progress for cpb_snapshot, published on each
+        // refresh tick. The sequence is odd while a new copy is being written.
+        int64_t _snapshot_sequence;
+        int64_t _snapshot_words[CPB_SNAPSHOT_WORDS];
+
+        // Rate history with constant memory: when all slots are used, adjacent
+        // slots are merged and each slot covers twice as long from then on
+        int rate_history_count;
+        double rate_history_span;
+        double rate_history_time;
+        double rate_history_items;
+        double rate_history[CPB_RATE_HISTORY_POINTS]; // Items per second
+
+        CPB_Stats stats;
+
+        // Refresh tuning, see overhead_budget
+        double _refresh_time;
+        int64_t _check_stride;
+        int64_t _check_countdown;
+        int64_t _force_check; // Set by the watchdog when a tick is overdue
+        int64_t _tuning_updates;
+        double _render_cost;
+        double _clock_read_cost;
+
+        CPB_Alert alert;
+        int64_t alert_last_current;
+        double alert_last_progress_time;
+        double alert_rate_drop_since;
+
+        // Compiled bar format, see CPB_Config.format
+        bool _is_utf8;
+        uint32_t _format_fields; // Bit mask of the opcodes used
+        int _format_op_count;
+        CPB_FormatOp _format_ops[CPB_FORMAT_MAX_OPS];
+        char _format_literals[CPB_FORMAT_LITERALS_SIZE];
+
+        // Resource usage of the process, see show_resources. Negative if unknown.
+        double resource_sample_time;
+        double resource_cpu_time;
+        int64_t resource_read_bytes;
+        int64_t resource_write_bytes;
+        double cpu_percent;
+        int64_t rss_bytes;
+        double read_bytes_rate;
+        double write_bytes_rate;
+
+        // Per-item latency histogram, see cpb_record_latency
+        int64_t latency_count;
+        double latency_min;
+        double latency_max;
+        int64_t latency_buckets[CPB_LATENCY_BUCKETS];
+
+        // Background thread for stall detection and for bounding the time between
+        // clock reads, only used if stall_timeout > 0 or overhead_budget > 0
+        void *_watchdog;
+
+        // Non-blocking output, only allocated by cpb_start if nonblocking_output is set
+        void *_output;
+
+        // Log lines waiting to be written with the next frame, see cpb_log. The
+        // first _log_rendered_length bytes are already part of the latest frame.
+        size_t _log_length;
+        size_t _log_rendered_length;
+        size_t _last_line_length;
+        char _log_buffer[CPB_LOG_BUFFER_SIZE];
+
+        // Timer for event loop integration, only used after cpb_get_timer_fd
+        int _timer_fd;
+        int64_t _timer_last_current;
+        double _timer_interval;
+
+        // Clock source actually in use after falling back from unavailable ones
+        CPB_ClockSource _clock_source;
+
+        // Seconds per tick for QueryPerformanceCounter on Windows and for rdtsc
         double _timer_freq_inv;
     } internal;
 } CPB_ProgressBar;
 
+typedef struct CPB_PipelineStage
+{
+    char name[CPB_PIPELINE_STAGE_NAME_SIZE];
+    int64_t count;       // Items done by the stage
+    int64_t queue_depth; // Items waiting in front of the stage, -1 if not reported
+
+    // Only used by the refresh thread
+    int64_t last_count;
+    double rate;        // Items per second
+    double finish_time; // Seconds from the start until all items were done, or 0
+} CPB_PipelineStage;
+
+typedef struct CPB_Pipeline
+{
+    // End-to-end progress, i.e. the items done by the last stage. Its config sets
+    // the description, format and refresh time of the view.
+    CPB_ProgressBar progress_bar;
+
+    int stage_count;
+    CPB_PipelineStage stages[CPB_PIPELINE_MAX_STAGES];
+
+    struct
+    {
+        int bottleneck; // Index of the stage holding the others back, -1 if unknown
+        double last_refresh_time;
+        bool has_drawn;
+
+        // Background thread rendering the view every min_refresh_time
+        void *_refresher;
+    } internal;
+} CPB_Pipeline;
+
 /**
  * \brief Get the default configuration for a progress bar.
  */
@@ -83,6 +372,11 @@ void cpb_init(
 /**
  * \brief Start a progress bar.
  *
+ * If stall detection is enabled, this also starts a watchdog thread that keeps
+ * checking for stalls while no updates arrive. With overhead_budget, the same
+ * thread makes sure the clock is still read when updates slow down between
+ * clock reads. It is stopped by cpb_finish.
+ *
  * \param progress_bar The progress bar to start.
  */
 void cpb_start(CPB_ProgressBar *restrict progress_bar);
@@ -95,6 +389,100 @@ void cpb_start(CPB_ProgressBar *restrict progress_bar);
  */
 void cpb_update(CPB_ProgressBar *restrict progress_bar, int64_t current);
 
+/**
+ * \brief Add newly discovered work to the total of a progress bar.
+ *
+ * Safe to call from any thread, concurrently with cpb_update. Once the total has
+ * grown, the remaining time accounts for the rate at which work is currently
+ * discovered as well as the rate at which it is completed.
+ *
+ * \param progress_bar The progress bar.
+ * \param amount The amount of work to add.
+ */
+void cpb_add_total(CPB_ProgressBar *restrict progress_bar, int64_t amount);
+
+/**
+ * \brief Record how long a single item took.
+ *
+ * The duration is added to a fixed-size log-linear histogram inside the progress
+ * bar, so this never allocates and only costs a few instructions. NaN durations are
+ * ignored.
+ *
+ * \param progress_bar The progress bar.
+ * \param item_time The duration of the item in seconds.
+ */
+void cpb_record_latency(CPB_ProgressBar *restrict progress_bar, double item_time);
+
+/**
+ * \brief Update a progress bar and record how long the last item took.
+ *
+ * \param progress_bar The progress bar to update.
+ * \param current The current value of the progress bar.
+ * \param item_time The duration of the item in seconds.
+ */
+void cpb_update_timed(
+    CPB_ProgressBar *restrict progress_bar,
+    int64_t current,
+    double item_time
+);
+
+/**
+ * \brief Get a percentile of the durations recorded by cpb_record_latency.
+ *
+ * \param progress_bar The progress bar.
+ * \param percentile The percentile in [0, 100], e.g. 99.0.
+ *
+ * \return The duration in seconds, or 0.0 if nothing has been recorded.
+ */
+double cpb_get_latency_percentile(
+    const CPB_ProgressBar *restrict progress_bar,
+    double percentile
+);
+
+/**
+ * \brief Print a line above a running progress bar.
+ *
+ * The line is buffered and written out together with the next frame, which clears
+ * the bar line first and redraws the bar below the buffered lines. Heavy logging
+ * therefore costs one redraw per refresh instead of one per line. A newline is
+ * appended if missing. Before cpb_start and after cpb_finish the line is printed
+ * directly. Call it from the thread that calls cpb_update.
+ *
+ * When the buffer is full, it is written out with a frame right away. With
+ * nonblocking_output, this never waits for the output: if the output cannot take
+ * the buffered lines yet, the new line is dropped and counted in
+ * CPB_Stats.log_lines_dropped instead.
+ *
+ * \param progress_bar The progress bar.
+ * \param message The line to print.
+ */
+void cpb_log(CPB_ProgressBar *restrict progress_bar, const char *restrict message);
+
+/**
+ * \brief Print a formatted line above a running progress bar, see cpb_log.
+ *
+ * \param progress_bar The progress bar.
+ * \param format The printf format string.
+ */
+void cpb_printf(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict format,
+    ...
+);
+
+/**
+ * \brief Print a formatted line above a running progress bar, see cpb_log.
+ *
+ * \param progress_bar The progress bar.
+ * \param format The printf format string.
+ * \param args The arguments for the format string.
+ */
+void cpb_vprintf(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict format,
+    va_list args
+);
+
 /**
  * \brief Finish a progress bar.
  *
@@ -102,4 +490,186 @@ void cpb_update(CPB_ProgressBar *restrict progress_bar, int64_t current);
  */
 void cpb_finish(CPB_ProgressBar *restrict progress_bar);
 
+/**
+ * \brief Finish a progress bar whose work stopped before reaching the total.
+ *
+ * Like cpb_finish, but the last position is shown instead of 100%, and the
+ * remaining time as unknown.
+ *
+ * \param progress_bar The progress bar to finish.
+ */
+void cpb_abort(CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Get a timer file descriptor that drives the refreshes of a progress bar.
+ *
+ * The descriptor is a non-blocking timerfd firing at the refresh interval in use,
+ * which overhead_budget may raise above min_refresh_time over time.
+ * Register it for reading with an event loop (e.g. epoll) and call cpb_on_timer
+ * when it becomes readable. From then on, cpb_update only stores the new value
+ * without reading the clock. The descriptor is owned by the progress bar and is
+ * closed by cpb_finish. Only available on Linux.
+ *
+ * \param progress_bar The progress bar, after cpb_start.
+ *
+ * \return The file descriptor, or -1 if timerfd is not available.
+ */
+int cpb_get_timer_fd(CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Handle an expiration of the timer returned by cpb_get_timer_fd.
+ *
+ * Renders the progress bar only if the current value changed since the last
+ * render.
+ *
+ * \param progress_bar The progress bar.
+ */
+void cpb_on_timer(CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Get a consistent copy of the progress as of the last refresh tick.
+ *
+ * Safe to call from any thread while the progress bar is being updated, e.g. to
+ * report the progress on a status page. Readers never block the updating thread,
+ * and retry in the rare case they overlap with a refresh tick. Combine with
+ * the headless option when nothing should be rendered.
+ *
+ * \param progress_bar The progress bar, after cpb_init.
+ * \param snapshot Output for the copy.
+ */
+void cpb_snapshot(
+    const CPB_ProgressBar *restrict progress_bar,
+    CPB_Snapshot *restrict snapshot
+);
+
+/**
+ * \brief Get the self-instrumentation counters of a progress bar.
+ *
+ * The counters are always collected and only cost a few integer increments per
+ * update. Calling this after cpb_finish gives the total overhead of the run.
+ *
+ * \param progress_bar The progress bar to query.
+ * \param stats Output for the counters.
+ */
+void cpb_get_stats(
+    const CPB_ProgressBar *restrict progress_bar,
+    CPB_Stats *restrict stats
+);
+
+/**
+ * \brief Watch the progress of another process through /proc (Linux only).
+ *
+ * With CPB_PROCESS_FD_POSITION, the position of the file descriptor is compared
+ * with the size of the file it refers to. If fd is negative, the largest regular
+ * file opened by the process is used. The I/O counters do not have a total, so
+ * the caller has to provide one.
+ *
+ * \param source The source to initialize.
+ * \param pid The process to watch.
+ * \param fd The file descriptor to watch in that process, or -1.
+ * \param counter The counter to sample.
+ *
+ * \return true if the process (and file descriptor) could be found.
+ */
+bool cpb_process_source_init(
+    CPB_ProcessSource *restrict source,
+    int pid,
+    int fd,
+    CPB_ProcessCounter counter
+);
+
+/**
+ * \brief Sample the current value of a process source.
+ *
+ * \param source The source to sample.
+ * \param current Output for the current value in bytes.
+ *
+ * \return false once the process or file descriptor is gone.
+ */
+bool cpb_process_source_sample(
+    const CPB_ProcessSource *restrict source,
+    int64_t *restrict current
+);
+
+/**
+ * \brief Initialize a pipeline of stages connected by queues.
+ *
+ * The view has one line per stage with its rate and queue depth, followed by the
+ * end-to-end bar. The bottleneck, i.e. the slowest unfinished stage running clearly
+ * slower than the stage feeding it, is highlighted, and the remaining time is
+ * estimated from its rate. Stages are updated from any thread, and the view
+ * is rendered by a background thread. Without a terminal, the stage lines are only
+ * printed once the pipeline is finished.
+ *
+ * \param pipeline The pipeline to initialize.
+ * \param total The number of items going through the pipeline.
+ * \param config The configuration of the end-to-end bar.
+ */
+void cpb_pipeline_init(
+    CPB_Pipeline *restrict pipeline,
+    int64_t total,
+    CPB_Config config
+);
+
+/**
+ * \brief Add a stage to a pipeline, before cpb_pipeline_start.
+ *
+ * Stages are rendered in the order they are added, and the last one added defines
+ * the end-to-end progress.
+ *
+ * \param pipeline The pipeline.
+ * \param name The name of the stage.
+ *
+ * \return The index of the stage, or -1 if there are already
+ * CPB_PIPELINE_MAX_STAGES stages.
+ */
+int cpb_pipeline_add_stage(CPB_Pipeline *restrict pipeline, const char *restrict name);
+
+/**
+ * \brief Start a pipeline and its refresh thread.
+ *
+ * \param pipeline The pipeline to start.
+ */
+void cpb_pipeline_start(CPB_Pipeline *restrict pipeline);
+
+/**
+ * \brief Set the number of items done by a stage. Safe to call from any thread.
+ *
+ * \param pipeline The pipeline.
+ * \param stage The index of the stage.
+ * \param count The number of items done by the stage.
+ */
+void cpb_pipeline_update(CPB_Pipeline *restrict pipeline, int stage, int64_t count);
+
+/**
+ * \brief Add to the number of items done by a stage, for stages with several
+ * workers. Safe to call from any thread.
+ *
+ * \param pipeline The pipeline.
+ * \param stage The index of the stage.
+ * \param amount The number of items just done.
+ */
+void cpb_pipeline_add(CPB_Pipeline *restrict pipeline, int stage, int64_t amount);
+
+/**
+ * \brief Set the number of items waiting in front of a stage. Safe to call from
+ * any thread.
+ *
+ * \param pipeline The pipeline.
+ * \param stage The index of the stage.
+ * \param queue_depth The number of items in the queue of the stage.
+ */
+void cpb_pipeline_set_queue_depth(
+    CPB_Pipeline *restrict pipeline,
+    int stage,
+    int64_t queue_depth
+);
+
+/**
+ * \brief Finish a pipeline, stop its refresh thread and print the final view.
+ *
+ * \param pipeline The pipeline to finish.
+ */
+void cpb_pipeline_finish(CPB_Pipeline *restrict pipeline);
+
 #endif /* C_PROGRESS_BAR_H */
@@ -5,14 +5,23 @@
  * \author Ching-Yin Ng
  */
 
+#include <math.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "c_progress_bar.h"
+#include "internal/atomic_utils.h"
+#include "internal/format.h"
+#include "internal/frame_buffer.h"
 #include "internal/math_utils.h"
+#include "internal/progress_bar.h"
 #include "internal/system_utils.h"
+#include "internal/thread_utils.h"
 
 typedef struct
 {
@@ -38,23 +47,112 @@ typedef struct
     const char *color_percentage;
     const char *color_remaining_time;
     const char *color_elapsed_time;
+    const char *color_alert;
+    const char *color_rate;
+
+    const char *sparkline[8];
 
     const int spinner_animation_length;
     const char *spinner[9];
 } UTF8Codes;
 
-static bool update_timer_data(CPB_ProgressBar *restrict progress_bar);
-static void print_elapsed_time(const CPB_ProgressBar *restrict progress_bar);
-static void print_remaining_time(const CPB_ProgressBar *restrict progress_bar);
+// A partially written frame must be completed before the newest one starts
+typedef struct
+{
+    int fd;
+    size_t latest_frame_length;
+    size_t pending_frame_length;
+    size_t pending_frame_offset;
+    char latest_frame[CPB_OUTPUT_BUFFER_SIZE];
+    char pending_frame[CPB_OUTPUT_BUFFER_SIZE];
+} NonblockingOutput;
+
+static double read_clock(CPB_ProgressBar *restrict progress_bar);
+static void record_rate_history(
+    CPB_ProgressBar *restrict progress_bar,
+    double diff_time,
+    double diff_current
+);
+static int64_t double_to_word(double value);
+static double word_to_double(int64_t word);
+static void publish_snapshot(CPB_ProgressBar *restrict progress_bar);
+static void set_alert(CPB_ProgressBar *restrict progress_bar, CPB_Alert alert);
+static void check_alerts(CPB_ProgressBar *restrict progress_bar, double current_time);
+static void watchdog_tick(void *arg);
+static void print_elapsed_time(
+    const CPB_ProgressBar *restrict progress_bar,
+    FrameBuffer *restrict frame_buffer
+);
+static void print_remaining_time(
+    const CPB_ProgressBar *restrict progress_bar,
+    FrameBuffer *restrict frame_buffer
+);
+static void print_sparkline(
+    const CPB_ProgressBar *restrict progress_bar,
+    const UTF8Codes *restrict utf8_codes,
+    FrameBuffer *restrict frame_buffer
+);
+static void print_duration(FrameBuffer *restrict frame_buffer, double seconds);
+static void print_latency_histogram(CPB_ProgressBar *restrict progress_bar);
 static UTF8Codes get_utf8_codes(const CPB_ProgressBar *restrict progress_bar);
-static void print_progress_bar(const CPB_ProgressBar *restrict progress_bar);
+static void print_bar(
+    const CPB_ProgressBar *restrict progress_bar,
+    const UTF8Codes *restrict utf8_codes,
+    int width,
+    FrameBuffer *restrict frame_buffer
+);
+static void render_field(
+    const CPB_ProgressBar *restrict progress_bar,
+    const UTF8Codes *restrict utf8_codes,
+    const CPB_FormatOp *restrict op,
+    FrameBuffer *restrict frame_buffer
+);
+static size_t flush_nonblocking_output(
+    CPB_ProgressBar *restrict progress_bar,
+    bool must_deliver
+);
+static size_t render_own_frame(void *context, FrameBuffer *restrict frame_buffer);
+static void print_progress_bar(CPB_ProgressBar *restrict progress_bar);
+static void print_log_frame(CPB_ProgressBar *restrict progress_bar);
+static double record_render(
+    CPB_ProgressBar *restrict progress_bar,
+    double render_start,
+    size_t written
+);
+static void append_log(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict message,
+    size_t length
+);
+static void consume_rendered_log(CPB_ProgressBar *restrict progress_bar);
+static void tune_refresh_rate(
+    CPB_ProgressBar *restrict progress_bar,
+    double render_time
+);
 
 CPB_Config cpb_get_default_config(void)
 {
     CPB_Config config = {
         .description = "",
         .min_refresh_time = 0.1,
-        .timer_remaining_time_recent_weight = 0.3
+        .timer_remaining_time_recent_weight = 0.3,
+        .stall_timeout = 0.0,
+        .rate_drop_threshold = 0.0,
+        .rate_drop_window = 10.0,
+        .on_alert = NULL,
+        .alert_user_data = NULL,
+        .show_alerts = false,
+        .clock_source = CPB_CLOCK_MONOTONIC,
+        .clock_function = NULL,
+        .clock_user_data = NULL,
+        .nonblocking_output = false,
+        .show_latency = false,
+        .dump_latency_histogram = false,
+        .show_sparkline = false,
+        .overhead_budget = 0.0,
+        .format = NULL,
+        .show_resources = false,
+        .headless = false
     };
     return config;
 }
@@ -72,7 +170,9 @@ void cpb_init(
     }
 
     // Must call before using timer
-    progress_bar->internal._timer_freq_inv = get_timer_freq_inv();
+    progress_bar->internal._clock_source = resolve_clock_source(&config);
+    progress_bar->internal._timer_freq_inv =
+        get_timer_freq_inv(progress_bar->internal._clock_source);
 
     progress_bar->start = start;
     progress_bar->total = total;
@@ -85,13 +185,93 @@ void cpb_init(
 
     progress_bar->internal.updates_count = -1;
     progress_bar->internal.time_start = 0.0;
+    progress_bar->internal._is_aborted = false;
     progress_bar->internal.timer_time_last_update = 0.0;
     progress_bar->internal.timer_percentage_last_update = 0.0;
+    progress_bar->internal.timer_percentage_start = 0.0;
     for (int i = 0; i < CPB_TIMER_DATA_POINTS; i++)
     {
         progress_bar->internal.timer_time_diffs[i] = 0.0;
         progress_bar->internal.timer_percentage_diffs[i] = 0.0;
+        progress_bar->internal.timer_current_diffs[i] = 0.0;
+        progress_bar->internal.timer_total_diffs[i] = 0.0;
+    }
+    progress_bar->internal.timer_current_start = start;
+    progress_bar->internal.timer_total_start = total;
+    progress_bar->internal.timer_current_last_update = start;
+    progress_bar->internal.timer_total_last_update = total;
+    progress_bar->internal.bottleneck_rate = 0.0;
+    progress_bar->internal._snapshot_sequence = 0;
+    publish_snapshot(progress_bar);
+
+    progress_bar->internal.rate_history_count = 0;
+    progress_bar->internal.rate_history_span =
+        config.min_refresh_time > 0.05 ? config.min_refresh_time : 0.05;
+    progress_bar->internal.rate_history_time = 0.0;
+    progress_bar->internal.rate_history_items = 0.0;
+    for (int i = 0; i < CPB_RATE_HISTORY_POINTS; i++)
+    {
+        progress_bar->internal.rate_history[i] = 0.0;
+    }
+
+    progress_bar->internal.stats = (CPB_Stats){0};
+
+    // Terminal capabilities and the layout do not change while running, so the
+    // format is compiled once here instead of being parsed on every render
+    progress_bar->internal._is_utf8 =
+        should_use_utf8(stdout) && should_use_color(stdout);
+    if (config.format)
+    {
+        compile_format(progress_bar, config.format);
     }
+    else
+    {
+        char default_format[CPB_FORMAT_LITERALS_SIZE];
+        build_default_format(&config, default_format, sizeof(default_format));
+        compile_format(progress_bar, default_format);
+    }
+
+    progress_bar->internal._refresh_time = config.min_refresh_time;
+    progress_bar->internal._check_stride = 1;
+    progress_bar->internal._check_countdown = 1;
+    progress_bar->internal._force_check = 0;
+    progress_bar->internal._tuning_updates = 0;
+    progress_bar->internal._render_cost = 0.0;
+    progress_bar->internal._clock_read_cost =
+        config.overhead_budget > 0.0 ? measure_clock_read_cost(progress_bar) : 0.0;
+
+    progress_bar->internal.resource_sample_time = -1.0;
+    progress_bar->internal.resource_cpu_time = -1.0;
+    progress_bar->internal.resource_read_bytes = -1;
+    progress_bar->internal.resource_write_bytes = -1;
+    progress_bar->internal.cpu_percent = -1.0;
+    progress_bar->internal.rss_bytes = -1;
+    progress_bar->internal.read_bytes_rate = -1.0;
+    progress_bar->internal.write_bytes_rate = -1.0;
+
+    progress_bar->internal.latency_count = 0;
+    progress_bar->internal.latency_min = 0.0;
+    progress_bar->internal.latency_max = 0.0;
+    for (int i = 0; i < CPB_LATENCY_BUCKETS; i++)
+    {
+        progress_bar->internal.latency_buckets[i] = 0;
+    }
+
+    progress_bar->internal.alert = CPB_ALERT_NONE;
+    progress_bar->internal.alert_last_current = start;
+    progress_bar->internal.alert_last_progress_time = 0.0;
+    progress_bar->internal.alert_rate_drop_since = -1.0;
+    progress_bar->internal._watchdog = NULL;
+
+    progress_bar->internal._output = NULL;
+
+    progress_bar->internal._log_length = 0;
+    progress_bar->internal._log_rendered_length = 0;
+    progress_bar->internal._last_line_length = 0;
+
+    progress_bar->internal._timer_fd = -1;
+    progress_bar->internal._timer_last_current = start;
+    progress_bar->internal._timer_interval = 0.0;
 }
 
 void cpb_start(CPB_ProgressBar *restrict progress_bar)
@@ -101,11 +281,28 @@ void cpb_start(CPB_ProgressBar *restrict progress_bar)
         return;
     }
 
+    open_output(progress_bar);
+
     progress_bar->is_started = true;
     if (update_timer_data(progress_bar))
     {
         print_progress_bar(progress_bar);
     }
+
+    const double stall_timeout = progress_bar->config.stall_timeout;
+    const bool has_budget = progress_bar->config.overhead_budget > 0.0;
+    if ((stall_timeout > 0.0 || has_budget) && !progress_bar->internal._watchdog)
+    {
+        // Check a few times per timeout so that stalls are reported close to on time,
+        // and every refresh interval with a budget so that overdue ticks are too
+        double interval = progress_bar->internal._refresh_time;
+        if (stall_timeout / 4.0 > interval && !has_budget)
+        {
+            interval = stall_timeout / 4.0;
+        }
+        progress_bar->internal._watchdog =
+            periodic_thread_start(watchdog_tick, progress_bar, interval);
+    }
 }
 
 void cpb_update(CPB_ProgressBar *restrict progress_bar, int64_t current)
@@ -115,314 +312,1536 @@ void cpb_update(CPB_ProgressBar *restrict progress_bar, int64_t current)
         return;
     }
 
-    progress_bar->current = current;
-    if (!update_timer_data(progress_bar))
+    // The stall watchdog reads these concurrently, and only this thread writes them
+    atomic_store_i64(&progress_bar->current, current);
+    atomic_store_i64(
+        &progress_bar->internal.stats.updates, progress_bar->internal.stats.updates + 1
+    );
+
+    // Driven by cpb_on_timer instead, so there is nothing else to do
+    if (progress_bar->internal._timer_fd >= 0)
     {
         return;
     }
 
-    print_progress_bar(progress_bar);
-}
-
-void cpb_finish(CPB_ProgressBar *restrict progress_bar)
-{
-    if (!progress_bar)
+    // Only read the clock on every n-th update, see tune_refresh_rate
+    if (progress_bar->internal._check_countdown > 1 &&
+        !atomic_load_i64(&progress_bar->internal._force_check))
     {
+        progress_bar->internal._check_countdown--;
+        progress_bar->internal.stats.suppressed_updates++;
         return;
     }
 
-    progress_bar->is_finished = true;
+    // Only taken when the stall watchdog runs, as it may render concurrently
+    PeriodicThread *watchdog = progress_bar->internal._watchdog;
+    if (watchdog)
+    {
+        periodic_thread_lock(watchdog);
+    }
+
+    atomic_store_i64(&progress_bar->internal._force_check, 0);
     if (update_timer_data(progress_bar))
     {
         print_progress_bar(progress_bar);
     }
+    else
+    {
+        progress_bar->internal.stats.suppressed_updates++;
+    }
+    progress_bar->internal._check_countdown = progress_bar->internal._check_stride;
+
+    if (watchdog)
+    {
+        periodic_thread_unlock(watchdog);
+    }
 }
 
-static bool update_timer_data(CPB_ProgressBar *restrict progress_bar)
+void cpb_add_total(CPB_ProgressBar *restrict progress_bar, int64_t amount)
 {
     if (!progress_bar)
     {
-        return false;
+        return;
     }
 
-    if (progress_bar->is_finished)
+    atomic_fetch_add_i64(&progress_bar->total, amount);
+}
+
+void cpb_record_latency(CPB_ProgressBar *restrict progress_bar, double item_time)
+{
+    if (!progress_bar)
     {
-        progress_bar->internal.timer_time_last_update =
-            get_monotonic_time(progress_bar);
-        progress_bar->internal.timer_percentage_last_update = 100.0;
-        return true;
+        return;
     }
 
-    if (progress_bar->internal.updates_count < 0)
+    // NaN has no place in the histogram
+    if (isnan(item_time))
     {
-        const double current_time = get_monotonic_time(progress_bar);
-        progress_bar->internal.time_start = current_time;
-        progress_bar->internal.timer_time_last_update = current_time;
-        progress_bar->internal.timer_percentage_last_update =
-            calculate_percentage(progress_bar);
-        progress_bar->internal.updates_count = 0;
-        return true;
+        return;
     }
 
-    const double current_time = get_monotonic_time(progress_bar);
-    const double diff_time =
-        current_time - progress_bar->internal.timer_time_last_update;
-    if (diff_time < progress_bar->config.min_refresh_time)
+    // Durations above a million seconds all fall into the last bucket anyway, and
+    // clamping keeps the conversion to nanoseconds within range
+    if (item_time < 0.0)
     {
-        return false;
+        item_time = 0.0;
+    }
+    else if (item_time > 1e6)
+    {
+        item_time = 1e6;
     }
 
-    const double current_percentage = calculate_percentage(progress_bar);
-    const double diff_percentage =
-        current_percentage - progress_bar->internal.timer_percentage_last_update;
-    progress_bar->internal.timer_time_diffs
-        [progress_bar->internal.updates_count % CPB_TIMER_DATA_POINTS] = diff_time;
-    progress_bar->internal.timer_percentage_diffs
-        [progress_bar->internal.updates_count % CPB_TIMER_DATA_POINTS] =
-        diff_percentage;
-
-    progress_bar->internal.timer_time_last_update = current_time;
-    progress_bar->internal.timer_percentage_last_update = current_percentage;
-    progress_bar->internal.updates_count++;
+    if (progress_bar->internal.latency_count == 0)
+    {
+        progress_bar->internal.latency_min = item_time;
+        progress_bar->internal.latency_max = item_time;
+    }
+    else if (item_time < progress_bar->internal.latency_min)
+    {
+        progress_bar->internal.latency_min = item_time;
+    }
+    else if (item_time > progress_bar->internal.latency_max)
+    {
+        progress_bar->internal.latency_max = item_time;
+    }
 
-    return true;
+    const int bucket = calculate_latency_bucket((uint64_t)(item_time * 1e9));
+    progress_bar->internal.latency_buckets[bucket]++;
+    progress_bar->internal.latency_count++;
 }
 
-static void print_elapsed_time(const CPB_ProgressBar *restrict progress_bar)
+void cpb_update_timed(
+    CPB_ProgressBar *restrict progress_bar,
+    int64_t current,
+    double item_time
+)
 {
-    const double elapsed_time =
-        (progress_bar->internal.timer_time_last_update -
-         progress_bar->internal.time_start);
-
-    // Calculate elapsed hours, minutes and seconds
-    const int hours = ((int)elapsed_time) / 3600;
-    const int minutes = ((int)elapsed_time % 3600) / 60;
-    const int seconds = ((int)elapsed_time % 60);
+    cpb_record_latency(progress_bar, item_time);
+    cpb_update(progress_bar, current);
+}
 
-    if (hours < 0 || minutes < 0 || seconds < 0)
-    {
-        fputs("--:--:--", stdout);
-    }
-    else
+double cpb_get_latency_percentile(
+    const CPB_ProgressBar *restrict progress_bar,
+    double percentile
+)
+{
+    if (!progress_bar)
     {
-        printf("%02d:%02d:%02d", hours, minutes, seconds);
+        return 0.0;
     }
+
+    return calculate_latency_percentile(progress_bar, percentile);
 }
 
-static void print_remaining_time(const CPB_ProgressBar *restrict progress_bar)
+void cpb_log(CPB_ProgressBar *restrict progress_bar, const char *restrict message)
 {
-    const double overall_rate = calculate_overall_rate(progress_bar);
-    const double recent_rate = calculate_recent_rate(progress_bar);
-    const double blended_rate =
-        progress_bar->config.timer_remaining_time_recent_weight * recent_rate +
-        (1.0 - progress_bar->config.timer_remaining_time_recent_weight) * overall_rate;
-
-    if (blended_rate <= 0.0)
+    if (!progress_bar || !message)
     {
-        fputs("--:--:--", stdout);
         return;
     }
 
-    const double remaining_percentage =
-        100.0 - progress_bar->internal.timer_percentage_last_update;
-    const double estimated_remaining_time = remaining_percentage / blended_rate;
+    append_log(progress_bar, message, strlen(message));
+}
 
-    // Calculate remaining hours, minutes and seconds
-    const int hours = ((int)estimated_remaining_time) / 3600;
-    const int minutes = ((int)estimated_remaining_time % 3600) / 60;
-    const int seconds = ((int)estimated_remaining_time % 60);
+void cpb_printf(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict format,
+    ...
+)
+{
+    va_list args;
+    va_start(args, format);
+    cpb_vprintf(progress_bar, format, args);
+    va_end(args);
+}
 
-    if (hours < 0 || minutes < 0 || seconds < 0)
+void cpb_vprintf(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict format,
+    va_list args
+)
+{
+    if (!progress_bar || !format)
     {
-        fputs("--:--:--", stdout);
+        return;
     }
-    else
+
+    char message[CPB_LOG_BUFFER_SIZE];
+    const int length = vsnprintf(message, sizeof(message), format, args);
+    if (length < 0)
     {
-        printf("%02d:%02d:%02d", hours, minutes, seconds);
+        return;
     }
+
+    append_log(
+        progress_bar,
+        message,
+        (size_t)length < sizeof(message) ? (size_t)length : sizeof(message) - 1
+    );
 }
 
-static UTF8Codes get_utf8_codes(const CPB_ProgressBar *restrict progress_bar)
+void cpb_finish(CPB_ProgressBar *restrict progress_bar)
 {
-    (void)progress_bar; // Reserved for future use
-    if (should_use_utf8(stdout) && should_use_color(stdout))
+    if (!progress_bar)
     {
-        return (UTF8Codes){
-            .is_utf8 = true,
-
-            .reset = "\033[0m",
-            .erase_current_line = "\033[2K",
-            .disable_cursor = "\033[?25l",
-            .enable_cursor = "\033[?25h",
-
-            .bar_prefix = "",
-            .bar_suffix = "",
-            .bar_fill = "\u2501",
-            .bar_empty = "\u2501",
-            .bar_fill_head = "\u2578",
-            .bar_empty_head = "\u257A",
-            .separator = "\u2022",
-
-            .color_spinner = "\033[0;32m",
-            .color_fill = "\033[38;5;197m",
-            .color_fill_after_ended = "\033[38;5;106m",
-            .color_empty = "\033[0;90m",
-            .color_percentage = "\033[0;35m",
-            .color_remaining_time = "\033[0;36m",
-            .color_elapsed_time = "\033[0;33m",
+        return;
+    }
 
-            .spinner_animation_length = 9,
-            .spinner =
-                {
-                    "\u280B",
-                    "\u2819",
-                    "\u2839",
-                    "\u2838",
-                    "\u283C",
-                    "\u2834",
-                    "\u2826",
-                    "\u2827",
-                    "\u2807",
-                },
-        };
+    if (progress_bar->internal._watchdog)
+    {
+        periodic_thread_stop(progress_bar->internal._watchdog);
+        progress_bar->internal._watchdog = NULL;
     }
-    else
+
+    if (progress_bar->internal._timer_fd >= 0)
     {
-        return (UTF8Codes){
-            .is_utf8 = false,
+        close_timer_fd(progress_bar->internal._timer_fd);
+        progress_bar->internal._timer_fd = -1;
+    }
 
-            .reset = "",
-            .erase_current_line = "",
-            .disable_cursor = "",
-            .enable_cursor = "",
+    progress_bar->is_finished = true;
+    if (update_timer_data(progress_bar))
+    {
+        print_progress_bar(progress_bar);
+    }
 
-            .bar_prefix = "[",
-            .bar_suffix = "]",
-            .bar_fill = "=",
-            .bar_empty = " ",
-            .bar_fill_head = ">",
-            .bar_empty_head = ">",
-            .separator = "*",
+    if (progress_bar->config.dump_latency_histogram)
+    {
+        print_latency_histogram(progress_bar);
+    }
 
-            .color_spinner = "",
-            .color_fill = "",
-            .color_fill_after_ended = "",
-            .color_empty = "",
-            .color_percentage = "",
-            .color_remaining_time = "",
-            .color_elapsed_time = "",
+    close_output(progress_bar);
+}
 
-            .spinner_animation_length = -1,
-            .spinner = {NULL},
-        };
+void cpb_abort(CPB_ProgressBar *restrict progress_bar)
+{
+    if (!progress_bar)
+    {
+        return;
     }
+
+    progress_bar->internal._is_aborted = true;
+    cpb_finish(progress_bar);
 }
 
-static void print_progress_bar(const CPB_ProgressBar *restrict progress_bar)
+int cpb_get_timer_fd(CPB_ProgressBar *restrict progress_bar)
 {
-    const UTF8Codes utf8_codes = get_utf8_codes(progress_bar);
-    fputs("\r", stdout);
-    if (utf8_codes.is_utf8)
+    if (!progress_bar || progress_bar->is_finished)
     {
-        fputs(utf8_codes.reset, stdout);
-        fputs(utf8_codes.disable_cursor, stdout);
-        fputs(utf8_codes.erase_current_line, stdout);
+        return -1;
     }
 
-    const double percentage = progress_bar->internal.timer_percentage_last_update;
-    const double clamped =
-        percentage < 0.0 ? 0.0 : (percentage > 100.0 ? 100.0 : percentage);
+    if (progress_bar->internal._timer_fd < 0)
+    {
+        const double interval = progress_bar->internal._refresh_time;
+        progress_bar->internal._timer_fd = create_timer_fd(interval);
+        progress_bar->internal._timer_interval = interval;
+        progress_bar->internal._timer_last_current =
+            atomic_load_i64(&progress_bar->current);
+    }
 
-    const int total_half_cells = CPB_PROGRESS_BAR_DEFAULT_WIDTH * 2;
-    const int filled_half_cells = (int)(clamped / 100.0 * total_half_cells);
-    const int full_cells = filled_half_cells / 2;
-    const bool has_left_half_cell = filled_half_cells % 2 > 0;
-    const int empty_cells = CPB_PROGRESS_BAR_DEFAULT_WIDTH - full_cells;
-    const bool has_right_half_cell = !has_left_half_cell && empty_cells > 0;
+    return progress_bar->internal._timer_fd;
+}
 
-    const char *fill_color = progress_bar->is_finished
-                                 ? utf8_codes.color_fill_after_ended
-                                 : utf8_codes.color_fill;
+void cpb_on_timer(CPB_ProgressBar *restrict progress_bar)
+{
+    if (!progress_bar || progress_bar->internal._timer_fd < 0)
+    {
+        return;
+    }
 
-    // Spinner
-    if (utf8_codes.spinner_animation_length > 0)
+    drain_timer_fd(progress_bar->internal._timer_fd);
+    const int64_t current = atomic_load_i64(&progress_bar->current);
+    if (current == progress_bar->internal._timer_last_current &&
+        progress_bar->internal._log_length == 0)
     {
-        const int spinner_index =
-            progress_bar->internal.updates_count % utf8_codes.spinner_animation_length;
-        fputs(utf8_codes.color_spinner, stdout);
-        fputs(utf8_codes.spinner[spinner_index], stdout);
-        fputs(utf8_codes.reset, stdout);
-        fputs(" ", stdout);
+        return;
     }
 
-    // Description
-    const char *description = progress_bar->config.description;
-    if (description[0] != '\0')
+    PeriodicThread *watchdog = progress_bar->internal._watchdog;
+    if (watchdog)
     {
-        fputs(description, stdout);
-        fputs(" ", stdout);
+        periodic_thread_lock(watchdog);
     }
 
-    // Filled cells
-    fputs(utf8_codes.bar_prefix, stdout);
-    if (filled_half_cells > 0)
+    progress_bar->internal._timer_last_current = current;
+    if (update_timer_data(progress_bar))
     {
-        fputs(fill_color, stdout);
-        for (int i = 0; i < full_cells; i++)
-        {
-            fputs(utf8_codes.bar_fill, stdout);
-        }
+        print_progress_bar(progress_bar);
+    }
 
-        if (has_left_half_cell)
-        {
-            fputs(utf8_codes.bar_fill_head, stdout);
-        }
-        fputs(utf8_codes.reset, stdout);
+    if (watchdog)
+    {
+        periodic_thread_unlock(watchdog);
     }
+}
 
-    // Unfilled cells
-    if (empty_cells > 0)
+void cpb_snapshot(
+    const CPB_ProgressBar *restrict progress_bar,
+    CPB_Snapshot *restrict snapshot
+)
+{
+    if (!progress_bar || !snapshot)
     {
-        fputs(utf8_codes.color_empty, stdout);
+        return;
+    }
 
-        if (has_right_half_cell)
+    // Retry until no refresh tick overlapped with the copy
+    const int64_t *sequence = &progress_bar->internal._snapshot_sequence;
+    int64_t words[CPB_SNAPSHOT_WORDS];
+    for (;;)
+    {
+        const int64_t begin = atomic_load_i64(sequence);
+        atomic_fence_acquire();
+        for (int i = 0; i < CPB_SNAPSHOT_WORDS; i++)
         {
-            fputs(utf8_codes.bar_empty_head, stdout);
+            words[i] = atomic_load_i64(&progress_bar->internal._snapshot_words[i]);
         }
-
-        int i = (has_left_half_cell || has_right_half_cell) ? 1 : 0;
-        for (; i < empty_cells; i++)
+        atomic_fence_acquire();
+        if (begin % 2 == 0 && atomic_load_i64(sequence) == begin)
         {
-            fputs(utf8_codes.bar_empty, stdout);
+            break;
         }
     }
-    fputs(utf8_codes.reset, stdout);
-    fputs(utf8_codes.bar_suffix, stdout);
 
-    // Extra Info
-    printf(
-        " %s%3d%%%s %s ",
-        utf8_codes.color_percentage,
-        (int)clamped,
-        utf8_codes.reset,
-        utf8_codes.separator
-    );
-    fputs(utf8_codes.color_elapsed_time, stdout);
-    print_elapsed_time(progress_bar);
-    fputs(utf8_codes.reset, stdout);
-    fputs(" ", stdout);
-    fputs(utf8_codes.separator, stdout);
-    fputs(" ", stdout);
-    fputs(utf8_codes.color_remaining_time, stdout);
-    print_remaining_time(progress_bar);
-    fputs(utf8_codes.reset, stdout);
+    snapshot->current = words[0];
+    snapshot->total = words[1];
+    snapshot->percentage = word_to_double(words[2]);
+    snapshot->elapsed_time = word_to_double(words[3]);
+    snapshot->remaining_time = word_to_double(words[4]);
+    snapshot->rate = word_to_double(words[5]);
+    snapshot->overall_rate = word_to_double(words[6]);
+    snapshot->is_started = (words[7] & 1) != 0;
+    snapshot->is_finished = (words[7] & 2) != 0;
+}
 
-    // Reset cursor
-    if (progress_bar->is_finished)
+void cpb_get_stats(
+    const CPB_ProgressBar *restrict progress_bar,
+    CPB_Stats *restrict stats
+)
+{
+    if (!progress_bar || !stats)
     {
-        fputs(utf8_codes.enable_cursor, stdout);
-        fputs("\n", stdout);
+        return;
     }
 
+    // The watchdog also reads the clock and may render, which updates the counters
+    PeriodicThread *watchdog = progress_bar->internal._watchdog;
+    if (watchdog)
+    {
+        periodic_thread_lock(watchdog);
+    }
+
+    *stats = progress_bar->internal.stats;
+    stats->effective_refresh_time = progress_bar->internal._refresh_time;
+    stats->check_stride = progress_bar->internal._check_stride;
+
+    if (watchdog)
+    {
+        periodic_thread_unlock(watchdog);
+    }
+}
+
+static double read_clock(CPB_ProgressBar *restrict progress_bar)
+{
+    progress_bar->internal.stats.clock_reads++;
+    return get_monotonic_time(progress_bar);
+}
+
+bool update_timer_data(CPB_ProgressBar *restrict progress_bar)
+{
+    if (!progress_bar)
+    {
+        return false;
+    }
+
+    if (progress_bar->is_finished)
+    {
+        progress_bar->internal.timer_time_last_update = read_clock(progress_bar);
+        progress_bar->internal.timer_percentage_last_update =
+            progress_bar->internal._is_aborted ? calculate_percentage(progress_bar)
+                                               : 100.0;
+        progress_bar->internal.timer_current_last_update =
+            atomic_load_i64(&progress_bar->current);
+        progress_bar->internal.timer_total_last_update =
+            atomic_load_i64(&progress_bar->total);
+        publish_snapshot(progress_bar);
+        return true;
+    }
+
+    if (progress_bar->internal.updates_count < 0)
+    {
+        const int64_t current = atomic_load_i64(&progress_bar->current);
+        const double current_time = read_clock(progress_bar);
+        progress_bar->internal.time_start = current_time;
+        progress_bar->internal.timer_time_last_update = current_time;
+        progress_bar->internal.timer_percentage_last_update =
+            calculate_percentage(progress_bar);
+        progress_bar->internal.timer_percentage_start =
+            progress_bar->internal.timer_percentage_last_update;
+        progress_bar->internal.timer_current_start = current;
+        progress_bar->internal.timer_total_start =
+            atomic_load_i64(&progress_bar->total);
+        progress_bar->internal.timer_current_last_update =
+            progress_bar->internal.timer_current_start;
+        progress_bar->internal.timer_total_last_update =
+            progress_bar->internal.timer_total_start;
+        progress_bar->internal.updates_count = 0;
+        progress_bar->internal.alert_last_current = current;
+        progress_bar->internal.alert_last_progress_time = current_time;
+        publish_snapshot(progress_bar);
+        return true;
+    }
+
+    const double current_time = read_clock(progress_bar);
+    const double diff_time =
+        current_time - progress_bar->internal.timer_time_last_update;
+
+    // With a timer fd, the timer already paces the refreshes
+    if (diff_time < progress_bar->internal._refresh_time &&
+        progress_bar->internal._timer_fd < 0)
+    {
+        return false;
+    }
+
+    const double current_percentage = calculate_percentage(progress_bar);
+    const double diff_percentage =
+        current_percentage - progress_bar->internal.timer_percentage_last_update;
+    const int64_t current = atomic_load_i64(&progress_bar->current);
+    const int64_t total = atomic_load_i64(&progress_bar->total);
+    const double diff_current =
+        (double)(current - progress_bar->internal.timer_current_last_update);
+    const double diff_total =
+        (double)(total - progress_bar->internal.timer_total_last_update);
+
+    const int64_t index = progress_bar->internal.updates_count % CPB_TIMER_DATA_POINTS;
+    progress_bar->internal.timer_time_diffs[index] = diff_time;
+    progress_bar->internal.timer_percentage_diffs[index] = diff_percentage;
+    progress_bar->internal.timer_current_diffs[index] = diff_current;
+    progress_bar->internal.timer_total_diffs[index] = diff_total;
+
+    progress_bar->internal.timer_time_last_update = current_time;
+    progress_bar->internal.timer_percentage_last_update = current_percentage;
+    progress_bar->internal.timer_current_last_update = current;
+    progress_bar->internal.timer_total_last_update = total;
+    progress_bar->internal.updates_count++;
+
+    record_rate_history(progress_bar, diff_time, diff_current);
+    check_alerts(progress_bar, current_time);
+    publish_snapshot(progress_bar);
+
+    return true;
+}
+
+static int64_t double_to_word(double value)
+{
+    int64_t word;
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+static double word_to_double(int64_t word)
+{
+    double value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+static void publish_snapshot(CPB_ProgressBar *restrict progress_bar)
+{
+    const double elapsed_time =
+        (progress_bar->internal.timer_time_last_update -
+         progress_bar->internal.time_start);
+    const int64_t current = progress_bar->internal.timer_current_last_update;
+    const int64_t words[CPB_SNAPSHOT_WORDS] = {
+        current,
+        progress_bar->internal.timer_total_last_update,
+        double_to_word(progress_bar->internal.timer_percentage_last_update),
+        double_to_word(elapsed_time),
+        double_to_word(calculate_remaining_time(progress_bar)),
+        double_to_word(calculate_item_rate(progress_bar)),
+        double_to_word(
+            elapsed_time > 0.0
+                ? (double)(current - progress_bar->internal.timer_current_start) /
+                      elapsed_time
+                : 0.0
+        ),
+        (progress_bar->is_started ? 1 : 0) | (progress_bar->is_finished ? 2 : 0),
+    };
+
+    // There is only one writer at a time, so the sequence needs no read-modify-write
+    int64_t *sequence = &progress_bar->internal._snapshot_sequence;
+    const int64_t next = atomic_load_i64(sequence) + 1;
+    atomic_store_i64(sequence, next);
+    atomic_fence_release();
+    for (int i = 0; i < CPB_SNAPSHOT_WORDS; i++)
+    {
+        atomic_store_i64(&progress_bar->internal._snapshot_words[i], words[i]);
+    }
+    atomic_fence_release();
+    atomic_store_i64(sequence, next + 1);
+}
+
+static void record_rate_history(
+    CPB_ProgressBar *restrict progress_bar,
+    double diff_time,
+    double diff_current
+)
+{
+    progress_bar->internal.rate_history_time += diff_time;
+    progress_bar->internal.rate_history_items += diff_current;
+    if (progress_bar->internal.rate_history_time <
+        progress_bar->internal.rate_history_span)
+    {
+        return;
+    }
+
+    // Halve the resolution instead of growing when the history is full
+    double *history = progress_bar->internal.rate_history;
+    if (progress_bar->internal.rate_history_count == CPB_RATE_HISTORY_POINTS)
+    {
+        for (int i = 0; i < CPB_RATE_HISTORY_POINTS / 2; i++)
+        {
+            history[i] = 0.5 * (history[2 * i] + history[2 * i + 1]);
+        }
+        progress_bar->internal.rate_history_count = CPB_RATE_HISTORY_POINTS / 2;
+        progress_bar->internal.rate_history_span *= 2.0;
+    }
+
+    history[progress_bar->internal.rate_history_count++] =
+        progress_bar->internal.rate_history_items /
+        progress_bar->internal.rate_history_time;
+    progress_bar->internal.rate_history_time = 0.0;
+    progress_bar->internal.rate_history_items = 0.0;
+}
+
+static void set_alert(CPB_ProgressBar *restrict progress_bar, CPB_Alert alert)
+{
+    if (progress_bar->internal.alert == alert)
+    {
+        return;
+    }
+
+    progress_bar->internal.alert = alert;
+    if (progress_bar->config.on_alert)
+    {
+        progress_bar->config.on_alert(
+            progress_bar, alert, progress_bar->config.alert_user_data
+        );
+    }
+}
+
+static void check_alerts(CPB_ProgressBar *restrict progress_bar, double current_time)
+{
+    // Stall: current has not moved for stall_timeout seconds
+    const int64_t current = atomic_load_i64(&progress_bar->current);
+    if (current != progress_bar->internal.alert_last_current)
+    {
+        progress_bar->internal.alert_last_current = current;
+        progress_bar->internal.alert_last_progress_time = current_time;
+    }
+
+    const double stall_timeout = progress_bar->config.stall_timeout;
+    if (stall_timeout > 0.0 &&
+        current_time - progress_bar->internal.alert_last_progress_time >= stall_timeout)
+    {
+        set_alert(progress_bar, CPB_ALERT_STALL);
+        return;
+    }
+
+    // Rate drop: recent rate below a fraction of the overall rate for a while.
+    // The recent rate is only meaningful once the ring of diffs is full. Item rates
+    // are compared, as percentage rates also drop when the total grows.
+    const double threshold = progress_bar->config.rate_drop_threshold;
+    bool is_rate_dropped = false;
+    if (threshold > 0.0 && progress_bar->internal.updates_count > CPB_TIMER_DATA_POINTS)
+    {
+        const double overall_rate = calculate_overall_item_rate(progress_bar);
+        const double recent_rate = calculate_recent_item_rate(progress_bar);
+        if (recent_rate < threshold * overall_rate)
+        {
+            if (progress_bar->internal.alert_rate_drop_since < 0.0)
+            {
+                progress_bar->internal.alert_rate_drop_since = current_time;
+            }
+            const double dropped_time =
+                current_time - progress_bar->internal.alert_rate_drop_since;
+            is_rate_dropped = dropped_time >= progress_bar->config.rate_drop_window;
+        }
+        else
+        {
+            progress_bar->internal.alert_rate_drop_since = -1.0;
+        }
+    }
+
+    set_alert(progress_bar, is_rate_dropped ? CPB_ALERT_RATE_DROP : CPB_ALERT_NONE);
+}
+
+static void watchdog_tick(void *arg)
+{
+    // Called with the watchdog lock held, so no refresh tick runs concurrently
+    CPB_ProgressBar *progress_bar = arg;
+    if (progress_bar->is_finished || progress_bar->internal.updates_count < 0)
+    {
+        return;
+    }
+
+    // Updates are still arriving and checking the alerts themselves
+    const double current_time = read_clock(progress_bar);
+    if (current_time - progress_bar->internal.timer_time_last_update <
+        progress_bar->internal._refresh_time)
+    {
+        return;
+    }
+
+    // The tick is overdue, e.g. as updates slowed down after the stride was tuned.
+    // Make the next update read the clock, which also tunes the stride down.
+    atomic_store_i64(&progress_bar->internal._force_check, 1);
+
+    if (progress_bar->config.stall_timeout <= 0.0)
+    {
+        return;
+    }
+    if (update_timer_data(progress_bar) && progress_bar->config.show_alerts &&
+        progress_bar->internal.alert != CPB_ALERT_NONE)
+    {
+        print_progress_bar(progress_bar);
+    }
+}
+
+static void print_elapsed_time(
+    const CPB_ProgressBar *restrict progress_bar,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    const double elapsed_time =
+        (progress_bar->internal.timer_time_last_update -
+         progress_bar->internal.time_start);
+
+    // Calculate elapsed hours, minutes and seconds
+    const int hours = ((int)elapsed_time) / 3600;
+    const int minutes = ((int)elapsed_time % 3600) / 60;
+    const int seconds = ((int)elapsed_time % 60);
+
+    if (hours < 0 || minutes < 0 || seconds < 0)
+    {
+        frame_buffer_puts(frame_buffer, "--:--:--");
+    }
+    else
+    {
+        frame_buffer_printf(frame_buffer, "%02d:%02d:%02d", hours, minutes, seconds);
+    }
+}
+
+static void print_remaining_time(
+    const CPB_ProgressBar *restrict progress_bar,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    const double estimated_remaining_time = calculate_remaining_time(progress_bar);
+    if (estimated_remaining_time < 0.0)
+    {
+        frame_buffer_puts(frame_buffer, "--:--:--");
+        return;
+    }
+
+    // Calculate remaining hours, minutes and seconds
+    const int hours = ((int)estimated_remaining_time) / 3600;
+    const int minutes = ((int)estimated_remaining_time % 3600) / 60;
+    const int seconds = ((int)estimated_remaining_time % 60);
+
+    if (hours < 0 || minutes < 0 || seconds < 0)
+    {
+        frame_buffer_puts(frame_buffer, "--:--:--");
+    }
+    else
+    {
+        frame_buffer_printf(frame_buffer, "%02d:%02d:%02d", hours, minutes, seconds);
+    }
+}
+
+static void print_sparkline(
+    const CPB_ProgressBar *restrict progress_bar,
+    const UTF8Codes *restrict utf8_codes,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    const int count = progress_bar->internal.rate_history_count;
+    const double *history = progress_bar->internal.rate_history;
+
+    double max_rate = 0.0;
+    for (int i = 0; i < count; i++)
+    {
+        if (history[i] > max_rate)
+        {
+            max_rate = history[i];
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int level = 0;
+        if (max_rate > 0.0 && history[i] > 0.0)
+        {
+            level = (int)(history[i] / max_rate * 7.0 + 0.5);
+        }
+        frame_buffer_puts(frame_buffer, utf8_codes->sparkline[level]);
+    }
+}
+
+static void print_duration(FrameBuffer *restrict frame_buffer, double seconds)
+{
+    if (seconds < 1e-6)
+    {
+        frame_buffer_printf(frame_buffer, "%.0fns", seconds * 1e9);
+    }
+    else if (seconds < 1e-3)
+    {
+        frame_buffer_printf(frame_buffer, "%.1fus", seconds * 1e6);
+    }
+    else if (seconds < 1.0)
+    {
+        frame_buffer_printf(frame_buffer, "%.1fms", seconds * 1e3);
+    }
+    else
+    {
+        frame_buffer_printf(frame_buffer, "%.2fs", seconds);
+    }
+}
+
+static void print_latency_histogram(CPB_ProgressBar *restrict progress_bar)
+{
+    if (progress_bar->internal.latency_count <= 0)
+    {
+        return;
+    }
+
+    // Printed line by line, since the histogram can be longer than one frame
+    char buffer[256];
+    FrameBuffer frame_buffer;
+    frame_buffer_init(&frame_buffer, buffer, sizeof(buffer));
+
+    const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+    frame_buffer_printf(
+        &frame_buffer,
+        "Latency (%lld items): min ",
+        (long long)progress_bar->internal.latency_count
+    );
+    print_duration(&frame_buffer, progress_bar->internal.latency_min);
+    for (int i = 0; i < 4; i++)
+    {
+        frame_buffer_printf(&frame_buffer, ", p%g ", percentiles[i]);
+        print_duration(
+            &frame_buffer, calculate_latency_percentile(progress_bar, percentiles[i])
+        );
+    }
+    frame_buffer_puts(&frame_buffer, ", max ");
+    print_duration(&frame_buffer, progress_bar->internal.latency_max);
+    frame_buffer_puts(&frame_buffer, "\n");
+    fputs(frame_buffer.data, stdout);
+
+    for (int bucket = 0; bucket < CPB_LATENCY_BUCKETS; bucket++)
+    {
+        const int64_t count = progress_bar->internal.latency_buckets[bucket];
+        if (count == 0)
+        {
+            continue;
+        }
+
+        frame_buffer_init(&frame_buffer, buffer, sizeof(buffer));
+        frame_buffer_puts(&frame_buffer, "  ");
+        print_duration(
+            &frame_buffer, (double)calculate_latency_bucket_lower_bound(bucket) * 1e-9
+        );
+        frame_buffer_puts(&frame_buffer, " - ");
+        print_duration(
+            &frame_buffer,
+            (double)calculate_latency_bucket_lower_bound(bucket + 1) * 1e-9
+        );
+        frame_buffer_printf(
+            &frame_buffer,
+            ": %lld (%.2f%%)\n",
+            (long long)count,
+            100.0 * (double)count / (double)progress_bar->internal.latency_count
+        );
+        fputs(frame_buffer.data, stdout);
+    }
+    fflush(stdout);
+}
+
+static UTF8Codes get_utf8_codes(const CPB_ProgressBar *restrict progress_bar)
+{
+    if (progress_bar->internal._is_utf8)
+    {
+        return (UTF8Codes){
+            .is_utf8 = true,
+
+            .reset = "\033[0m",
+            .erase_current_line = "\033[2K",
+            .disable_cursor = "\033[?25l",
+            .enable_cursor = "\033[?25h",
+
+            .bar_prefix = "",
+            .bar_suffix = "",
+            .bar_fill = "\u2501",
+            .bar_empty = "\u2501",
+            .bar_fill_head = "\u2578",
+            .bar_empty_head = "\u257A",
+            .separator = "\u2022",
+
+            .color_spinner = "\033[0;32m",
+            .color_fill = "\033[38;5;197m",
+            .color_fill_after_ended = "\033[38;5;106m",
+            .color_empty = "\033[0;90m",
+            .color_percentage = "\033[0;35m",
+            .color_remaining_time = "\033[0;36m",
+            .color_elapsed_time = "\033[0;33m",
+            .color_alert = "\033[0;31m",
+            .color_rate = "\033[0;32m",
+
+            .sparkline =
+                {
+                    "\u2581",
+                    "\u2582",
+                    "\u2583",
+                    "\u2584",
+                    "\u2585",
+                    "\u2586",
+                    "\u2587",
+                    "\u2588",
+                },
+
+            .spinner_animation_length = 9,
+            .spinner =
+                {
+                    "\u280B",
+                    "\u2819",
+                    "\u2839",
+                    "\u2838",
+                    "\u283C",
+                    "\u2834",
+                    "\u2826",
+                    "\u2827",
+                    "\u2807",
+                },
+        };
+    }
+    else
+    {
+        return (UTF8Codes){
+            .is_utf8 = false,
+
+            .reset = "",
+            .erase_current_line = "",
+            .disable_cursor = "",
+            .enable_cursor = "",
+
+            .bar_prefix = "[",
+            .bar_suffix = "]",
+            .bar_fill = "=",
+            .bar_empty = " ",
+            .bar_fill_head = ">",
+            .bar_empty_head = ">",
+            .separator = "*",
+
+            .color_spinner = "",
+            .color_fill = "",
+            .color_fill_after_ended = "",
+            .color_empty = "",
+            .color_percentage = "",
+            .color_remaining_time = "",
+            .color_elapsed_time = "",
+            .color_alert = "",
+            .color_rate = "",
+
+            .sparkline = {"_", ".", ",", "-", "~", "=", "*", "#"},
+
+            .spinner_animation_length = -1,
+            .spinner = {NULL},
+        };
+    }
+}
+
+static void print_bar(
+    const CPB_ProgressBar *restrict progress_bar,
+    const UTF8Codes *restrict utf8_codes,
+    int width,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    const double percentage = progress_bar->internal.timer_percentage_last_update;
+    const double clamped =
+        percentage < 0.0 ? 0.0 : (percentage > 100.0 ? 100.0 : percentage);
+
+    const int total_half_cells = width * 2;
+    const int filled_half_cells = (int)(clamped / 100.0 * total_half_cells);
+    const int full_cells = filled_half_cells / 2;
+    const bool has_left_half_cell = filled_half_cells % 2 > 0;
+    const int empty_cells = width - full_cells;
+    const bool has_right_half_cell = !has_left_half_cell && empty_cells > 0;
+
+    const char *fill_color =
+        progress_bar->is_finished && !progress_bar->internal._is_aborted
+            ? utf8_codes->color_fill_after_ended
+            : utf8_codes->color_fill;
+
+    // Filled cells
+    frame_buffer_puts(frame_buffer, utf8_codes->bar_prefix);
+    if (filled_half_cells > 0)
+    {
+        frame_buffer_puts(frame_buffer, fill_color);
+        for (int i = 0; i < full_cells; i++)
+        {
+            frame_buffer_puts(frame_buffer, utf8_codes->bar_fill);
+        }
+
+        if (has_left_half_cell)
+        {
+            frame_buffer_puts(frame_buffer, utf8_codes->bar_fill_head);
+        }
+        frame_buffer_puts(frame_buffer, utf8_codes->reset);
+    }
+
+    // Unfilled cells
+    if (empty_cells > 0)
+    {
+        frame_buffer_puts(frame_buffer, utf8_codes->color_empty);
+
+        if (has_right_half_cell)
+        {
+            frame_buffer_puts(frame_buffer, utf8_codes->bar_empty_head);
+        }
+
+        int i = (has_left_half_cell || has_right_half_cell) ? 1 : 0;
+        for (; i < empty_cells; i++)
+        {
+            frame_buffer_puts(frame_buffer, utf8_codes->bar_empty);
+        }
+    }
+    frame_buffer_puts(frame_buffer, utf8_codes->reset);
+    frame_buffer_puts(frame_buffer, utf8_codes->bar_suffix);
+}
+
+static void render_field(
+    const CPB_ProgressBar *restrict progress_bar,
+    const UTF8Codes *restrict utf8_codes,
+    const CPB_FormatOp *restrict op,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    // Fields that have nothing to show must not append anything, not even colors,
+    // so that the enclosing group can be dropped
+    switch ((FormatOpcode)op->opcode)
+    {
+        case FORMAT_OP_SPINNER:
+            if (utf8_codes->spinner_animation_length > 0)
+            {
+                const int spinner_index = progress_bar->internal.updates_count %
+                                          utf8_codes->spinner_animation_length;
+                frame_buffer_puts(frame_buffer, utf8_codes->color_spinner);
+                frame_buffer_puts(frame_buffer, utf8_codes->spinner[spinner_index]);
+                frame_buffer_puts(frame_buffer, utf8_codes->reset);
+            }
+            break;
+        case FORMAT_OP_DESCRIPTION:
+            frame_buffer_puts(frame_buffer, progress_bar->config.description);
+            break;
+        case FORMAT_OP_BAR:
+            print_bar(
+                progress_bar,
+                utf8_codes,
+                op->width > 0 ? op->width : CPB_PROGRESS_BAR_DEFAULT_WIDTH,
+                frame_buffer
+            );
+            break;
+        case FORMAT_OP_PERCENTAGE:
+        {
+            const double percentage =
+                progress_bar->internal.timer_percentage_last_update;
+            const double clamped =
+                percentage < 0.0 ? 0.0 : (percentage > 100.0 ? 100.0 : percentage);
+            frame_buffer_printf(
+                frame_buffer,
+                "%s%3d%%%s",
+                utf8_codes->color_percentage,
+                (int)clamped,
+                utf8_codes->reset
+            );
+            break;
+        }
+        case FORMAT_OP_ELAPSED:
+            frame_buffer_puts(frame_buffer, utf8_codes->color_elapsed_time);
+            print_elapsed_time(progress_bar, frame_buffer);
+            frame_buffer_puts(frame_buffer, utf8_codes->reset);
+            break;
+        case FORMAT_OP_REMAINING:
+            frame_buffer_puts(frame_buffer, utf8_codes->color_remaining_time);
+            print_remaining_time(progress_bar, frame_buffer);
+            frame_buffer_puts(frame_buffer, utf8_codes->reset);
+            break;
+        case FORMAT_OP_RATE:
+            frame_buffer_puts(frame_buffer, utf8_codes->color_rate);
+            frame_buffer_print_rate(frame_buffer, calculate_item_rate(progress_bar));
+            frame_buffer_puts(frame_buffer, utf8_codes->reset);
+            break;
+        case FORMAT_OP_SPARKLINE:
+            if (progress_bar->internal.rate_history_count > 0)
+            {
+                frame_buffer_puts(frame_buffer, utf8_codes->color_remaining_time);
+                print_sparkline(progress_bar, utf8_codes, frame_buffer);
+                frame_buffer_puts(frame_buffer, utf8_codes->reset);
+            }
+            break;
+        case FORMAT_OP_P50:
+        case FORMAT_OP_P99:
+            if (progress_bar->internal.latency_count > 0)
+            {
+                const double percentile = op->opcode == FORMAT_OP_P50 ? 50.0 : 99.0;
+                print_duration(
+                    frame_buffer, calculate_latency_percentile(progress_bar, percentile)
+                );
+            }
+            break;
+        case FORMAT_OP_CPU:
+            if (progress_bar->internal.cpu_percent >= 0.0)
+            {
+                frame_buffer_printf(
+                    frame_buffer, "%.0f%%", progress_bar->internal.cpu_percent
+                );
+            }
+            break;
+        case FORMAT_OP_RSS:
+            if (progress_bar->internal.rss_bytes >= 0)
+            {
+                frame_buffer_print_bytes(
+                    frame_buffer, (double)progress_bar->internal.rss_bytes
+                );
+            }
+            break;
+        case FORMAT_OP_READ:
+        case FORMAT_OP_WRITE:
+        {
+            const double bytes_rate = op->opcode == FORMAT_OP_READ
+                                          ? progress_bar->internal.read_bytes_rate
+                                          : progress_bar->internal.write_bytes_rate;
+            if (bytes_rate >= 0.0)
+            {
+                frame_buffer_print_bytes(frame_buffer, bytes_rate);
+                frame_buffer_puts(frame_buffer, "/s");
+            }
+            break;
+        }
+        case FORMAT_OP_ALERT:
+            if (progress_bar->internal.alert != CPB_ALERT_NONE)
+            {
+                frame_buffer_puts(frame_buffer, utf8_codes->color_alert);
+                frame_buffer_puts(
+                    frame_buffer,
+                    progress_bar->internal.alert == CPB_ALERT_STALL ? "STALLED" : "SLOW"
+                );
+                frame_buffer_puts(frame_buffer, utf8_codes->reset);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+size_t render_progress_bar(
+    const CPB_ProgressBar *restrict progress_bar,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    const UTF8Codes utf8_codes = get_utf8_codes(progress_bar);
+    frame_buffer_puts(frame_buffer, "\r");
+    if (utf8_codes.is_utf8)
+    {
+        frame_buffer_puts(frame_buffer, utf8_codes.reset);
+        frame_buffer_puts(frame_buffer, utf8_codes.disable_cursor);
+        frame_buffer_puts(frame_buffer, utf8_codes.erase_current_line);
+    }
+
+    // Pending log lines go where the bar was, and the bar is redrawn below them
+    const size_t log_length = progress_bar->internal._log_rendered_length;
+    if (log_length > 0)
+    {
+        if (!utf8_codes.is_utf8)
+        {
+            // Without escape codes, blank out the previous bar line with spaces
+            for (size_t i = 0; i < progress_bar->internal._last_line_length; i++)
+            {
+                frame_buffer_puts(frame_buffer, " ");
+            }
+            frame_buffer_puts(frame_buffer, "\r");
+        }
+        frame_buffer_write(
+            frame_buffer, progress_bar->internal._log_buffer, log_length
+        );
+    }
+    const size_t line_start = frame_buffer->length;
+
+    // Run the format program compiled by cpb_init
+    size_t group_start = 0;
+    bool is_group_empty = false;
+    for (int i = 0; i < progress_bar->internal._format_op_count; i++)
+    {
+        const CPB_FormatOp *op = &progress_bar->internal._format_ops[i];
+        const size_t length_before = frame_buffer->length;
+        switch ((FormatOpcode)op->opcode)
+        {
+            case FORMAT_OP_LITERAL:
+                frame_buffer_write(
+                    frame_buffer,
+                    progress_bar->internal._format_literals + op->literal_offset,
+                    op->literal_length
+                );
+                continue;
+            case FORMAT_OP_GROUP_BEGIN:
+                group_start = length_before;
+                is_group_empty = false;
+                continue;
+            case FORMAT_OP_GROUP_END:
+                // Drop the group with its literals if any of its fields was empty
+                if (is_group_empty)
+                {
+                    frame_buffer_truncate(frame_buffer, group_start);
+                }
+                is_group_empty = false;
+                continue;
+            case FORMAT_OP_SEPARATOR:
+                frame_buffer_puts(frame_buffer, utf8_codes.separator);
+                continue;
+            default:
+                render_field(progress_bar, &utf8_codes, op, frame_buffer);
+                break;
+        }
+
+        if (frame_buffer->length == length_before)
+        {
+            is_group_empty = true;
+        }
+    }
+
+    // Reset cursor
+    if (progress_bar->is_finished)
+    {
+        frame_buffer_puts(frame_buffer, utf8_codes.enable_cursor);
+        frame_buffer_puts(frame_buffer, "\n");
+    }
+
+    return line_start;
+}
+
+static size_t flush_nonblocking_output(
+    CPB_ProgressBar *restrict progress_bar,
+    bool must_deliver
+)
+{
+    NonblockingOutput *output = progress_bar->internal._output;
+    size_t written = 0;
+    for (;;)
+    {
+        const size_t offset = output->pending_frame_offset;
+        const size_t length = output->pending_frame_length;
+        if (offset < length)
+        {
+            const int64_t result = write_nonblocking(
+                output->fd, output->pending_frame + offset, length - offset
+            );
+            if (result > 0)
+            {
+                output->pending_frame_offset += (size_t)result;
+                written += (size_t)result;
+                continue;
+            }
+            if (result < 0)
+            {
+                // The output is gone, so nothing more can be delivered
+                output->pending_frame_length = 0;
+                output->pending_frame_offset = 0;
+                output->latest_frame_length = 0;
+                progress_bar->internal._log_length = 0;
+                progress_bar->internal._log_rendered_length = 0;
+                break;
+            }
+            if (!must_deliver)
+            {
+                break;
+            }
+            wait_until_writable(output->fd);
+            continue;
+        }
+
+        // Start writing the newest frame only once the previous one is complete
+        const size_t latest_length = output->latest_frame_length;
+        if (latest_length == 0)
+        {
+            break;
+        }
+        memcpy(
+            output->pending_frame,
+            output->latest_frame,
+            latest_length
+        );
+        output->pending_frame_length = latest_length;
+        output->pending_frame_offset = 0;
+        output->latest_frame_length = 0;
+        consume_rendered_log(progress_bar);
+    }
+
+    return written;
+}
+
+void open_output(CPB_ProgressBar *restrict progress_bar)
+{
+    if (!progress_bar->config.nonblocking_output || progress_bar->config.headless ||
+        progress_bar->internal._output)
+    {
+        return;
+    }
+
+    // Make sure earlier output reaches the terminal before any frame does
     fflush(stdout);
+    const int fd = open_nonblocking_output(stdout);
+    NonblockingOutput *output = fd >= 0 ? malloc(sizeof(NonblockingOutput)) : NULL;
+    if (output)
+    {
+        output->fd = fd;
+        output->latest_frame_length = 0;
+        output->pending_frame_length = 0;
+        output->pending_frame_offset = 0;
+        progress_bar->internal._output = output;
+    }
+    else
+    {
+        // Fall back to blocking output
+        close_nonblocking_output(fd);
+    }
+}
+
+void close_output(CPB_ProgressBar *restrict progress_bar)
+{
+    NonblockingOutput *output = progress_bar->internal._output;
+    if (output)
+    {
+        close_nonblocking_output(output->fd);
+        free(output);
+        progress_bar->internal._output = NULL;
+    }
+}
+
+size_t write_frame(
+    CPB_ProgressBar *progress_bar,
+    FrameRenderer render,
+    void *context
+)
+{
+    NonblockingOutput *output = progress_bar->internal._output;
+
+    char buffer[CPB_OUTPUT_BUFFER_SIZE];
+    FrameBuffer frame_buffer;
+    if (output)
+    {
+        // Render over the newest frame if it has not started being written yet
+        if (output->latest_frame_length > 0)
+        {
+            progress_bar->internal.stats.frames_dropped++;
+        }
+        frame_buffer_init(
+            &frame_buffer, output->latest_frame, sizeof(output->latest_frame)
+        );
+    }
+    else
+    {
+        frame_buffer_init(&frame_buffer, buffer, sizeof(buffer));
+    }
+
+    // Also render the log lines that were already part of a dropped frame
+    progress_bar->internal._log_rendered_length = progress_bar->internal._log_length;
+    const size_t line_start = render(context, &frame_buffer);
+    progress_bar->internal._last_line_length = frame_buffer.length - line_start;
+
+    size_t written;
+    if (output)
+    {
+        output->latest_frame_length = frame_buffer.length;
+        written = flush_nonblocking_output(progress_bar, progress_bar->is_finished);
+    }
+    else
+    {
+        written = fwrite(frame_buffer.data, 1, frame_buffer.length, stdout);
+        fflush(stdout);
+        consume_rendered_log(progress_bar);
+    }
+
+    return written;
+}
+
+static size_t render_own_frame(void *context, FrameBuffer *restrict frame_buffer)
+{
+    return render_progress_bar(context, frame_buffer);
+}
+
+static void print_progress_bar(CPB_ProgressBar *restrict progress_bar)
+{
+    sample_resources(progress_bar);
+
+    // Headless bars skip only the frame, so that ticks are counted and tuned alike
+    const size_t written =
+        progress_bar->config.headless
+            ? 0
+            : write_frame(progress_bar, render_own_frame, progress_bar);
+
+    // The render started when the timer data was last updated, which saves a clock read
+    const double render_time = record_render(
+        progress_bar,
+        progress_bar->internal.timer_time_last_update,
+        written
+    );
+
+    if (progress_bar->config.overhead_budget > 0.0)
+    {
+        tune_refresh_rate(progress_bar, render_time);
+    }
+}
+
+static void print_log_frame(CPB_ProgressBar *restrict progress_bar)
+{
+    // Not a tick, so the timer data is stale and the frame is kept out of the tuning
+    const double render_start = read_clock(progress_bar);
+    const size_t written = write_frame(progress_bar, render_own_frame, progress_bar);
+    record_render(progress_bar, render_start, written);
+}
+
+static double record_render(
+    CPB_ProgressBar *restrict progress_bar,
+    double render_start,
+    size_t written
+)
+{
+    const double render_time = read_clock(progress_bar) - render_start;
+    const int64_t render_ns = render_time > 0.0 ? (int64_t)(render_time * 1e9) : 0;
+
+    CPB_Stats *stats = &progress_bar->internal.stats;
+    stats->renders++;
+    stats->render_ns_total += render_ns;
+    if (render_ns > stats->render_ns_max)
+    {
+        stats->render_ns_max = render_ns;
+    }
+    stats->bytes_written += (int64_t)written;
+
+    return render_time;
+}
+
+void sample_resources(CPB_ProgressBar *restrict progress_bar)
+{
+    if (!(progress_bar->internal._format_fields & FORMAT_RESOURCE_FIELDS))
+    {
+        return;
+    }
+
+    // The clock was just read for the timer data, so reuse that reading
+    const double current_time = progress_bar->internal.timer_time_last_update;
+    const double diff_time = current_time - progress_bar->internal.resource_sample_time;
+    const bool has_previous = progress_bar->internal.resource_sample_time >= 0.0;
+
+    // A shorter window, e.g. up to the frame of cpb_finish, is too short for the
+    // counters to be meaningful, so the previous values are kept instead
+    if (has_previous &&
+        (diff_time <= 0.0 || diff_time < progress_bar->config.min_refresh_time))
+    {
+        return;
+    }
+
+    const double cpu_time = get_process_cpu_time();
+    if (has_previous && cpu_time >= 0.0 &&
+        progress_bar->internal.resource_cpu_time >= 0.0)
+    {
+        progress_bar->internal.cpu_percent =
+            100.0 * (cpu_time - progress_bar->internal.resource_cpu_time) / diff_time;
+    }
+    progress_bar->internal.resource_cpu_time = cpu_time;
+
+    progress_bar->internal.rss_bytes = get_process_rss();
+
+    int64_t read_bytes = -1;
+    int64_t write_bytes = -1;
+    if (get_process_io(&read_bytes, &write_bytes) && has_previous &&
+        progress_bar->internal.resource_read_bytes >= 0)
+    {
+        progress_bar->internal.read_bytes_rate =
+            (double)(read_bytes - progress_bar->internal.resource_read_bytes) /
+            diff_time;
+        progress_bar->internal.write_bytes_rate =
+            (double)(write_bytes - progress_bar->internal.resource_write_bytes) /
+            diff_time;
+    }
+    progress_bar->internal.resource_read_bytes = read_bytes;
+    progress_bar->internal.resource_write_bytes = write_bytes;
+
+    progress_bar->internal.resource_sample_time = current_time;
+}
+
+static void append_log(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict message,
+    size_t length
+)
+{
+    bool has_newline = length > 0 && message[length - 1] == '\n';
+    if (!progress_bar->is_started || progress_bar->is_finished ||
+        progress_bar->config.headless)
+    {
+        fwrite(message, 1, length, stdout);
+        if (!has_newline)
+        {
+            fputc('\n', stdout);
+        }
+        fflush(stdout);
+        return;
+    }
+
+    // Only taken when the stall watchdog runs, as it may render concurrently
+    PeriodicThread *watchdog = progress_bar->internal._watchdog;
+    if (watchdog)
+    {
+        periodic_thread_lock(watchdog);
+    }
+
+    // Make room by writing the buffered lines with a frame right away. Non-blocking
+    // output may still be busy with an earlier frame, and then the line is dropped
+    // rather than waited for, as the worker must never block on the output.
+    const size_t needed = length + (has_newline ? 0 : 1);
+    if (progress_bar->internal._log_length + needed > CPB_LOG_BUFFER_SIZE)
+    {
+        NonblockingOutput *output = progress_bar->internal._output;
+        if (output)
+        {
+            flush_nonblocking_output(progress_bar, false);
+        }
+        if (!output || output->pending_frame_offset >= output->pending_frame_length)
+        {
+            print_log_frame(progress_bar);
+        }
+
+        const size_t log_length = progress_bar->internal._log_length;
+        if (output && log_length > 0 && log_length + needed > CPB_LOG_BUFFER_SIZE)
+        {
+            progress_bar->internal.stats.log_lines_dropped++;
+            if (watchdog)
+            {
+                periodic_thread_unlock(watchdog);
+            }
+            return;
+        }
+    }
+
+    // A line longer than the whole buffer is cut off
+    const size_t available = CPB_LOG_BUFFER_SIZE - progress_bar->internal._log_length;
+    if (needed > available)
+    {
+        length = available - 1;
+        has_newline = false;
+    }
+
+    char *end = progress_bar->internal._log_buffer + progress_bar->internal._log_length;
+    memcpy(end, message, length);
+    if (!has_newline)
+    {
+        end[length++] = '\n';
+    }
+    progress_bar->internal._log_length += length;
+    progress_bar->internal.stats.log_lines++;
+
+    if (watchdog)
+    {
+        periodic_thread_unlock(watchdog);
+    }
+}
+
+static void consume_rendered_log(CPB_ProgressBar *restrict progress_bar)
+{
+    const size_t rendered = progress_bar->internal._log_rendered_length;
+    if (rendered == 0)
+    {
+        return;
+    }
+
+    // Lines logged after the frame was rendered wait for the next one
+    memmove(
+        progress_bar->internal._log_buffer,
+        progress_bar->internal._log_buffer + rendered,
+        progress_bar->internal._log_length - rendered
+    );
+    progress_bar->internal._log_length -= rendered;
+    progress_bar->internal._log_rendered_length = 0;
+}
+
+static void tune_refresh_rate(
+    CPB_ProgressBar *restrict progress_bar,
+    double render_time
+)
+{
+    if (progress_bar->internal.updates_count <= 0 || progress_bar->is_finished)
+    {
+        return;
+    }
+
+    // Smooth the render cost, a single slow frame should not stretch the interval
+    double render_cost = progress_bar->internal._render_cost;
+    render_cost =
+        render_cost > 0.0 ? 0.8 * render_cost + 0.2 * render_time : render_time;
+    progress_bar->internal._render_cost = render_cost;
+
+    // Half of the budget goes to rendering, the other half to reading the clock
+    const double half_budget = 0.5 * progress_bar->config.overhead_budget;
+    double refresh_time = render_cost / half_budget;
+    if (refresh_time < progress_bar->config.min_refresh_time)
+    {
+        refresh_time = progress_bar->config.min_refresh_time;
+    }
+    progress_bar->internal._refresh_time = refresh_time;
+
+    // Re-arm the timer fd only on larger changes, as every re-arm is a system call
+    const double timer_interval = progress_bar->internal._timer_interval;
+    if (progress_bar->internal._timer_fd >= 0 &&
+        (refresh_time > 1.25 * timer_interval || refresh_time < 0.8 * timer_interval))
+    {
+        set_timer_fd_interval(progress_bar->internal._timer_fd, refresh_time);
+        progress_bar->internal._timer_interval = refresh_time;
+    }
+
+    // Updates per second since the previous tick
+    const int64_t all_updates = atomic_load_i64(&progress_bar->internal.stats.updates);
+    const int64_t updates = all_updates - progress_bar->internal._tuning_updates;
+    progress_bar->internal._tuning_updates = all_updates;
+    const double diff_time = progress_bar->internal.timer_time_diffs
+        [(progress_bar->internal.updates_count - 1) % CPB_TIMER_DATA_POINTS];
+    if (diff_time <= 0.0)
+    {
+        return;
+    }
+    const double update_rate = (double)updates / diff_time;
+
+    // Keep a few clock reads per interval so that ticks are not delayed too much
+    double checks =
+        half_budget * refresh_time / progress_bar->internal._clock_read_cost;
+    if (checks < 4.0)
+    {
+        checks = 4.0;
+    }
+
+    // Grow gradually, as a stride that is too large delays noticing a slowdown
+    double stride = update_rate * refresh_time / checks;
+    const double max_stride = 2.0 * (double)progress_bar->internal._check_stride;
+    if (stride > max_stride)
+    {
+        stride = max_stride;
+    }
+    if (stride > CPB_MAX_CHECK_STRIDE)
+    {
+        stride = CPB_MAX_CHECK_STRIDE;
+    }
+    progress_bar->internal._check_stride = stride > 1.0 ? (int64_t)stride : 1;
 }
@@ -0,0 +1,202 @@
+/**
+ * \file format.c
+ * \brief Compilation of bar format strings for C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_progress_bar.h"
+#include "internal/format.h"
+
+typedef struct
+{
+    const char *name;
+    FormatOpcode opcode;
+} FormatField;
+
+static const FormatField format_fields[] = {
+    {"sep", FORMAT_OP_SEPARATOR},
+    {"spinner", FORMAT_OP_SPINNER},
+    {"desc", FORMAT_OP_DESCRIPTION},
+    {"bar", FORMAT_OP_BAR},
+    {"pct", FORMAT_OP_PERCENTAGE},
+    {"elapsed", FORMAT_OP_ELAPSED},
+    {"eta", FORMAT_OP_REMAINING},
+    {"rate", FORMAT_OP_RATE},
+    {"spark", FORMAT_OP_SPARKLINE},
+    {"p50", FORMAT_OP_P50},
+    {"p99", FORMAT_OP_P99},
+    {"alert", FORMAT_OP_ALERT},
+    {"cpu", FORMAT_OP_CPU},
+    {"rss", FORMAT_OP_RSS},
+    {"read", FORMAT_OP_READ},
+    {"write", FORMAT_OP_WRITE},
+};
+
+/**
+ * \brief Helper function to append an operation to the render program.
+ *
+ * \return The appended operation, or NULL if the program is full.
+ */
+static CPB_FormatOp *append_op(
+    CPB_ProgressBar *restrict progress_bar,
+    FormatOpcode opcode
+)
+{
+    if (progress_bar->internal._format_op_count >= CPB_FORMAT_MAX_OPS)
+    {
+        return NULL;
+    }
+
+    CPB_FormatOp *op =
+        &progress_bar->internal._format_ops[progress_bar->internal._format_op_count++];
+    op->opcode = (uint8_t)opcode;
+    progress_bar->internal._format_fields |= 1u << opcode;
+    op->width = 0;
+    op->literal_offset = 0;
+    op->literal_length = 0;
+    return op;
+}
+
+/**
+ * \brief Helper function to append literal text, merging it with the previous
+ * literal operation when possible.
+ */
+static void append_literal(
+    CPB_ProgressBar *restrict progress_bar,
+    size_t *restrict literals_length,
+    const char *text,
+    size_t length
+)
+{
+    // Always keep one byte for the null terminator
+    if (*literals_length + length >= CPB_FORMAT_LITERALS_SIZE)
+    {
+        return;
+    }
+
+    const int op_count = progress_bar->internal._format_op_count;
+    CPB_FormatOp *last =
+        op_count > 0 ? &progress_bar->internal._format_ops[op_count - 1] : NULL;
+    if (!last || last->opcode != FORMAT_OP_LITERAL ||
+        last->literal_offset + last->literal_length != *literals_length)
+    {
+        last = append_op(progress_bar, FORMAT_OP_LITERAL);
+        if (!last)
+        {
+            return;
+        }
+        last->literal_offset = (uint16_t)*literals_length;
+    }
+
+    memcpy(progress_bar->internal._format_literals + *literals_length, text, length);
+    *literals_length += length;
+    progress_bar->internal._format_literals[*literals_length] = '\0';
+    last->literal_length = (uint16_t)(last->literal_length + length);
+}
+
+void build_default_format(
+    const CPB_Config *restrict config,
+    char *restrict buffer,
+    size_t size
+)
+{
+    snprintf(
+        buffer,
+        size,
+        "{[{spinner} ]}{[{desc} ]}{bar} {pct} {sep} {elapsed} {sep} {eta}%s%s%s%s",
+        config->show_sparkline ? "{[ {sep} {spark}]}" : "",
+        config->show_latency ? "{[ {sep} p50 {p50} p99 {p99}]}" : "",
+        config->show_resources
+            ? "{[ {sep} cpu {cpu}]}{[ rss {rss}]}{[ r {read} w {write}]}"
+            : "",
+        config->show_alerts ? "{[ {sep} {alert}]}" : ""
+    );
+}
+
+void compile_format(CPB_ProgressBar *restrict progress_bar, const char *restrict format)
+{
+    progress_bar->internal._format_op_count = 0;
+    progress_bar->internal._format_fields = 0;
+    progress_bar->internal._format_literals[0] = '\0';
+    size_t literals_length = 0;
+
+    const char *p = format;
+    while (*p)
+    {
+        // Escaped braces
+        if ((p[0] == '{' && p[1] == '{') || (p[0] == '}' && p[1] == '}'))
+        {
+            append_literal(progress_bar, &literals_length, p, 1);
+            p += 2;
+            continue;
+        }
+
+        // Optional groups
+        if (p[0] == '{' && p[1] == '[')
+        {
+            append_op(progress_bar, FORMAT_OP_GROUP_BEGIN);
+            p += 2;
+            continue;
+        }
+        if (p[0] == ']' && p[1] == '}')
+        {
+            append_op(progress_bar, FORMAT_OP_GROUP_END);
+            p += 2;
+            continue;
+        }
+
+        // Fields
+        const char *end = p[0] == '{' ? strchr(p, '}') : NULL;
+        if (!end)
+        {
+            append_literal(progress_bar, &literals_length, p, 1);
+            p++;
+            continue;
+        }
+
+        const char *colon = memchr(p + 1, ':', (size_t)(end - p - 1));
+        const size_t name_length = (size_t)((colon ? colon : end) - p - 1);
+        const FormatField *field = NULL;
+        for (size_t i = 0; i < sizeof(format_fields) / sizeof(format_fields[0]); i++)
+        {
+            if (strlen(format_fields[i].name) == name_length &&
+                strncmp(format_fields[i].name, p + 1, name_length) == 0)
+            {
+                field = &format_fields[i];
+                break;
+            }
+        }
+
+        if (!field)
+        {
+            // Keep unknown fields visible, so that typos are easy to spot
+            append_literal(progress_bar, &literals_length, p, (size_t)(end - p + 1));
+        }
+        else
+        {
+            CPB_FormatOp *op = append_op(progress_bar, field->opcode);
+            if (op && colon)
+            {
+                int width = atoi(colon + 1);
+                if (width < 1)
+                {
+                    width = 1;
+                }
+                if (width > CPB_FORMAT_MAX_BAR_WIDTH)
+                {
+                    width = CPB_FORMAT_MAX_BAR_WIDTH;
+                }
+                op->width = (uint16_t)width;
+            }
+        }
+        p = end + 1;
+    }
+}
@@ -0,0 +1,129 @@
+/**
+ * \file frame_buffer.c
+ * \brief Fixed-size output buffer for rendering frames in C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "internal/frame_buffer.h"
+
+void frame_buffer_init(
+    FrameBuffer *restrict frame_buffer,
+    char *storage,
+    size_t capacity
+)
+{
+    frame_buffer->data = storage;
+    frame_buffer->capacity = capacity;
+    frame_buffer->length = 0;
+    frame_buffer->is_truncated = false;
+    if (capacity > 0)
+    {
+        storage[0] = '\0';
+    }
+}
+
+void frame_buffer_puts(FrameBuffer *restrict frame_buffer, const char *restrict str)
+{
+    frame_buffer_write(frame_buffer, str, strlen(str));
+}
+
+void frame_buffer_write(
+    FrameBuffer *restrict frame_buffer,
+    const char *restrict data,
+    size_t length
+)
+{
+    // Always keep one byte for the null terminator
+    if (frame_buffer->length + length >= frame_buffer->capacity)
+    {
+        frame_buffer->is_truncated = true;
+        return;
+    }
+
+    memcpy(frame_buffer->data + frame_buffer->length, data, length);
+    frame_buffer->length += length;
+    frame_buffer->data[frame_buffer->length] = '\0';
+}
+
+void frame_buffer_truncate(FrameBuffer *restrict frame_buffer, size_t length)
+{
+    if (length < frame_buffer->length)
+    {
+        frame_buffer->length = length;
+        frame_buffer->data[length] = '\0';
+    }
+}
+
+void frame_buffer_printf(
+    FrameBuffer *restrict frame_buffer,
+    const char *restrict format,
+    ...
+)
+{
+    const size_t available = frame_buffer->capacity - frame_buffer->length;
+
+    va_list args;
+    va_start(args, format);
+    const int written =
+        vsnprintf(frame_buffer->data + frame_buffer->length, available, format, args);
+    va_end(args);
+
+    if (written < 0 || (size_t)written >= available)
+    {
+        // Roll back the partial output so that escape codes are never cut in half
+        frame_buffer->data[frame_buffer->length] = '\0';
+        frame_buffer->is_truncated = true;
+        return;
+    }
+
+    frame_buffer->length += (size_t)written;
+}
+
+void frame_buffer_print_rate(FrameBuffer *restrict frame_buffer, double rate)
+{
+    if (rate >= 1e9)
+    {
+        frame_buffer_printf(frame_buffer, "%.2fG/s", rate * 1e-9);
+    }
+    else if (rate >= 1e6)
+    {
+        frame_buffer_printf(frame_buffer, "%.2fM/s", rate * 1e-6);
+    }
+    else if (rate >= 1e3)
+    {
+        frame_buffer_printf(frame_buffer, "%.2fk/s", rate * 1e-3);
+    }
+    else
+    {
+        frame_buffer_printf(frame_buffer, "%.2f/s", rate);
+    }
+}
+
+void frame_buffer_print_bytes(FrameBuffer *restrict frame_buffer, double bytes)
+{
+    const double mebibyte = 1024.0 * 1024.0;
+    const double gibibyte = 1024.0 * mebibyte;
+    if (bytes >= gibibyte)
+    {
+        frame_buffer_printf(frame_buffer, "%.1fGiB", bytes / gibibyte);
+    }
+    else if (bytes >= mebibyte)
+    {
+        frame_buffer_printf(frame_buffer, "%.1fMiB", bytes / mebibyte);
+    }
+    else if (bytes >= 1024.0)
+    {
+        frame_buffer_printf(frame_buffer, "%.1fKiB", bytes / 1024.0);
+    }
+    else
+    {
+        frame_buffer_printf(frame_buffer, "%.0fB", bytes);
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * \file atomic_utils.h
+ * \brief Atomic operations on 64-bit integers for C Progress Bar library.
+ *
+ * C99 has no atomics, so these wrap the compiler builtins. All operations are
+ * relaxed; they only guarantee that values are never torn. Ordering, where needed,
+ * comes from the explicit fences.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_PROGRESS_BAR_INTERNAL_ATOMIC_UTILS_H
+#define C_PROGRESS_BAR_INTERNAL_ATOMIC_UTILS_H
+
+#include <stdint.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/**
+ * \brief Atomically load a 64-bit integer.
+ *
+ * \param[in] ptr Pointer to the value.
+ * \return The value.
+ */
+static inline int64_t atomic_load_i64(const int64_t *ptr)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    // Aligned 64-bit loads are atomic on x64
+    return *(const volatile int64_t *)ptr;
+#else
+    return *ptr;
+#endif
+}
+
+/**
+ * \brief Atomically store a 64-bit integer.
+ *
+ * \param[out] ptr Pointer to the value.
+ * \param[in] value The new value.
+ */
+static inline void atomic_store_i64(int64_t *ptr, int64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *(volatile int64_t *)ptr = value;
+#else
+    *ptr = value;
+#endif
+}
+
+/**
+ * \brief Atomically add to a 64-bit integer.
+ *
+ * \param[in,out] ptr Pointer to the value.
+ * \param[in] value The value to add.
+ * \return The value before the addition.
+ */
+static inline int64_t atomic_fetch_add_i64(int64_t *ptr, int64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_fetch_add(ptr, value, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER)
+    return _InterlockedExchangeAdd64((volatile long long *)ptr, value);
+#else
+    const int64_t old = *ptr;
+    *ptr = old + value;
+    return old;
+#endif
+}
+
+/**
+ * \brief Order all earlier loads before any later load or store.
+ */
+static inline void atomic_fence_acquire(void)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+    // Loads are not reordered with other loads or later stores on x86 and x64
+    _ReadWriteBarrier();
+#endif
+}
+
+/**
+ * \brief Order all earlier loads and stores before any later store.
+ */
+static inline void atomic_fence_release(void)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#elif defined(_MSC_VER)
+    // Stores are not reordered with other stores or earlier loads on x86 and x64
+    _ReadWriteBarrier();
+#endif
+}
+
+#endif /* C_PROGRESS_BAR_INTERNAL_ATOMIC_UTILS_H */
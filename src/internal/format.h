@@ -0,0 +1,71 @@
+/**
+ * \file format.h
+ * \brief Compilation of bar format strings for C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_PROGRESS_BAR_INTERNAL_FORMAT_H
+#define C_PROGRESS_BAR_INTERNAL_FORMAT_H
+
+#include <stddef.h>
+
+#include "c_progress_bar.h"
+
+typedef enum FormatOpcode
+{
+    FORMAT_OP_LITERAL = 0,
+    FORMAT_OP_GROUP_BEGIN, // "{[": the group is dropped if one of its fields is empty
+    FORMAT_OP_GROUP_END,   // "]}"
+    FORMAT_OP_SEPARATOR,   // "{sep}": decoration, never counts as an empty field
+
+    FORMAT_OP_SPINNER,     // "{spinner}"
+    FORMAT_OP_DESCRIPTION, // "{desc}"
+    FORMAT_OP_BAR,         // "{bar}" or "{bar:<width>}"
+    FORMAT_OP_PERCENTAGE,  // "{pct}"
+    FORMAT_OP_ELAPSED,     // "{elapsed}"
+    FORMAT_OP_REMAINING,   // "{eta}"
+    FORMAT_OP_RATE,        // "{rate}": items per second
+    FORMAT_OP_SPARKLINE,   // "{spark}"
+    FORMAT_OP_P50,         // "{p50}"
+    FORMAT_OP_P99,         // "{p99}"
+    FORMAT_OP_ALERT,       // "{alert}"
+    FORMAT_OP_CPU,         // "{cpu}": CPU usage of the process
+    FORMAT_OP_RSS,         // "{rss}": resident set size
+    FORMAT_OP_READ,        // "{read}": bytes read per second
+    FORMAT_OP_WRITE,       // "{write}": bytes written per second
+} FormatOpcode;
+
+// Fields that need the resource usage of the process to be sampled
+#define FORMAT_RESOURCE_FIELDS                                                       \
+    ((1u << FORMAT_OP_CPU) | (1u << FORMAT_OP_RSS) | (1u << FORMAT_OP_READ) |      \
+     (1u << FORMAT_OP_WRITE))
+
+/**
+ * \brief Write the format string of the built-in layout for a configuration.
+ *
+ * \param[in] config The progress bar configuration.
+ * \param[out] buffer Output for the format string.
+ * \param[in] size The size of the buffer.
+ */
+void build_default_format(
+    const CPB_Config *restrict config,
+    char *restrict buffer,
+    size_t size
+);
+
+/**
+ * \brief Compile a format string into the render program of a progress bar.
+ *
+ * Unknown fields are kept as literal text. Anything beyond CPB_FORMAT_MAX_OPS
+ * operations or CPB_FORMAT_LITERALS_SIZE bytes of literal text is dropped.
+ *
+ * \param[in,out] progress_bar The progress bar.
+ * \param[in] format The format string.
+ */
+void compile_format(
+    CPB_ProgressBar *restrict progress_bar,
+    const char *restrict format
+);
+
+#endif /* C_PROGRESS_BAR_INTERNAL_FORMAT_H */
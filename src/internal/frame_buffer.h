@@ -0,0 +1,94 @@
+/**
+ * \file frame_buffer.h
+ * \brief Fixed-size output buffer for rendering frames in C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_PROGRESS_BAR_INTERNAL_FRAME_BUFFER_H
+#define C_PROGRESS_BAR_INTERNAL_FRAME_BUFFER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct FrameBuffer
+{
+    char *data;
+    size_t capacity;
+    size_t length;
+    bool is_truncated;
+} FrameBuffer;
+
+/**
+ * \brief Initialize a frame buffer on top of caller-provided storage.
+ *
+ * \param[out] frame_buffer The frame buffer to initialize.
+ * \param[in] storage The storage backing the buffer.
+ * \param[in] capacity The size of the storage in bytes.
+ */
+void frame_buffer_init(
+    FrameBuffer *restrict frame_buffer,
+    char *storage,
+    size_t capacity
+);
+
+/**
+ * \brief Append a string to the frame buffer.
+ *
+ * Output that does not fit is dropped and the buffer is marked as truncated.
+ *
+ * \param[in,out] frame_buffer The frame buffer.
+ * \param[in] str The string to append.
+ */
+void frame_buffer_puts(FrameBuffer *restrict frame_buffer, const char *restrict str);
+
+/**
+ * \brief Append a number of bytes to the frame buffer.
+ *
+ * \param[in,out] frame_buffer The frame buffer.
+ * \param[in] data The bytes to append.
+ * \param[in] length The number of bytes.
+ */
+void frame_buffer_write(
+    FrameBuffer *restrict frame_buffer,
+    const char *restrict data,
+    size_t length
+);
+
+/**
+ * \brief Discard everything appended after the given length.
+ *
+ * \param[in,out] frame_buffer The frame buffer.
+ * \param[in] length The length to truncate to.
+ */
+void frame_buffer_truncate(FrameBuffer *restrict frame_buffer, size_t length);
+
+/**
+ * \brief Append formatted output to the frame buffer.
+ *
+ * \param[in,out] frame_buffer The frame buffer.
+ * \param[in] format The printf-style format string.
+ */
+void frame_buffer_printf(
+    FrameBuffer *restrict frame_buffer,
+    const char *restrict format,
+    ...
+);
+
+/**
+ * \brief Append a rate in items per second with a k, M or G suffix.
+ *
+ * \param[in,out] frame_buffer The frame buffer.
+ * \param[in] rate The rate in items per second.
+ */
+void frame_buffer_print_rate(FrameBuffer *restrict frame_buffer, double rate);
+
+/**
+ * \brief Append a number of bytes with a KiB, MiB or GiB suffix.
+ *
+ * \param[in,out] frame_buffer The frame buffer.
+ * \param[in] bytes The number of bytes.
+ */
+void frame_buffer_print_bytes(FrameBuffer *restrict frame_buffer, double bytes);
+
+#endif /* C_PROGRESS_BAR_INTERNAL_FRAME_BUFFER_H */
@@ -40,4 +40,81 @@ double calculate_overall_rate(const CPB_ProgressBar *restrict progress_bar);
  */
 double calculate_recent_rate(const CPB_ProgressBar *restrict progress_bar);
 
+/**
+ * \brief Calculate the overall rate of progress in items per second.
+ *
+ * Unlike the percentage rates, this is not distorted by a growing total.
+ *
+ * \param[in] progress_bar Pointer to the progress bar structure.
+ *
+ * \return The overall rate of progress in items per second.
+ */
+double calculate_overall_item_rate(const CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Calculate the recent rate of progress in items per second based on recent
+ * updates.
+ *
+ * \param[in] progress_bar Pointer to the progress bar structure.
+ *
+ * \return The recent rate of progress in items per second.
+ */
+double calculate_recent_item_rate(const CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Calculate the rate of progress in items per second.
+ *
+ * Blends the recent and overall rates with timer_remaining_time_recent_weight.
+ *
+ * \param[in] progress_bar Pointer to the progress bar structure.
+ *
+ * \return The rate of progress in items per second.
+ */
+double calculate_item_rate(const CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Calculate the estimated remaining time.
+ *
+ * Blends the recent and overall rates with timer_remaining_time_recent_weight.
+ * If the total has grown since the start, the rate at which work was discovered
+ * over the recent refresh ticks is subtracted from the rate at which it is
+ * completed.
+ *
+ * \param[in] progress_bar Pointer to the progress bar structure.
+ *
+ * \return The remaining time in seconds, or a negative value if it is unknown.
+ */
+double calculate_remaining_time(const CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Get the latency histogram bucket of a duration.
+ *
+ * \param[in] nanoseconds The duration in nanoseconds.
+ *
+ * \return The bucket index in [0, CPB_LATENCY_BUCKETS).
+ */
+int calculate_latency_bucket(uint64_t nanoseconds);
+
+/**
+ * \brief Get the lower bound of a latency histogram bucket.
+ *
+ * \param[in] bucket The bucket index.
+ *
+ * \return The smallest duration in the bucket, in nanoseconds.
+ */
+uint64_t calculate_latency_bucket_lower_bound(int bucket);
+
+/**
+ * \brief Calculate a percentile of the latency histogram.
+ *
+ * \param[in] progress_bar Pointer to the progress bar structure.
+ * \param[in] percentile The percentile in [0, 100].
+ *
+ * \return The duration in seconds, or 0.0 if the histogram is empty.
+ */
+double calculate_latency_percentile(
+    const CPB_ProgressBar *restrict progress_bar,
+    double percentile
+);
+
 #endif /* C_PROGRESS_BAR_INTERNAL_MATH_UTILS_H */
@@ -0,0 +1,90 @@
+/**
+ * \file progress_bar.h
+ * \brief Progress bar internals shared with other modules of C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_PROGRESS_BAR_INTERNAL_PROGRESS_BAR_H
+#define C_PROGRESS_BAR_INTERNAL_PROGRESS_BAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "c_progress_bar.h"
+#include "frame_buffer.h"
+
+/**
+ * \brief Take a new data point for the time estimations from the current value.
+ *
+ * \param[in,out] progress_bar The progress bar.
+ *
+ * \return true if the progress bar should be rendered.
+ */
+bool update_timer_data(CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Render the bar line of a progress bar, along with pending log lines.
+ *
+ * \param[in] progress_bar The progress bar.
+ * \param[in,out] frame_buffer The frame buffer to render into.
+ *
+ * \return The offset in the frame buffer where the bar line starts.
+ */
+size_t render_progress_bar(
+    const CPB_ProgressBar *restrict progress_bar,
+    FrameBuffer *restrict frame_buffer
+);
+
+/**
+ * \brief Render a whole frame, see render_progress_bar.
+ *
+ * \param[in] context The context given to write_frame.
+ * \param[in,out] frame_buffer The frame buffer to render into.
+ *
+ * \return The offset in the frame buffer where the bar line starts.
+ */
+typedef size_t (*FrameRenderer)(void *context, FrameBuffer *restrict frame_buffer);
+
+/**
+ * \brief Set up non-blocking output if the config asks for it, before the first frame.
+ *
+ * \param[in,out] progress_bar The progress bar.
+ */
+void open_output(CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Release the non-blocking output, after the last frame.
+ *
+ * \param[in,out] progress_bar The progress bar.
+ */
+void close_output(CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Render a frame along with pending log lines and write it to the output.
+ *
+ * With non-blocking output, the frame replaces the newest one that has not started
+ * being written yet. Once the bar is finished, the frame is always delivered.
+ *
+ * \param[in,out] progress_bar The progress bar.
+ * \param[in] render The function rendering the frame.
+ * \param[in] context The context passed to render.
+ *
+ * \return The number of bytes written.
+ */
+size_t write_frame(
+    CPB_ProgressBar *progress_bar,
+    FrameRenderer render,
+    void *context
+);
+
+/**
+ * \brief Sample the resource usage of the process if the format shows it.
+ *
+ * Called on render ticks only, after update_timer_data.
+ *
+ * \param[in,out] progress_bar The progress bar.
+ */
+void sample_resources(CPB_ProgressBar *restrict progress_bar);
+
+#endif /* C_PROGRESS_BAR_INTERNAL_PROGRESS_BAR_H */
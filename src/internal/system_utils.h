@@ -9,6 +9,11 @@
 #define C_PROGRESS_BAR_INTERNAL_SYSTEM_UTILS_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "c_progress_bar.h"
 
 /**
  * \brief Determine if we should use UTF-8 encoding for the given output stream.
@@ -35,20 +40,138 @@ bool should_use_color(FILE *stream);
 int get_terminal_width(FILE *stream);
 
 /**
- * \brief Get the inverse of the timer frequency (for Windows).
+ * \brief Get the clock source to use for the given configuration.
+ *
+ * \param[in] config The progress bar configuration.
+ *
+ * \return The requested clock source if it is available on this system, otherwise
+ * CPB_CLOCK_MONOTONIC.
+ */
+CPB_ClockSource resolve_clock_source(const CPB_Config *restrict config);
+
+/**
+ * \brief Get the inverse of the timer frequency (for Windows and rdtsc).
+ *
+ * For CPB_CLOCK_TSC, this calibrates the TSC against the monotonic clock, which
+ * takes a few milliseconds.
+ *
+ * \param[in] clock_source The resolved clock source.
  *
  * \return The inverse of the timer frequency.
  */
-double get_timer_freq_inv(void);
+double get_timer_freq_inv(CPB_ClockSource clock_source);
 
 /**
  * \brief Get the current monotonic time in seconds.
  *
- * \param[in] progress_bar Pointer to the progress bar structure (for timer frequency on
- * Windows).
+ * \param[in] progress_bar Pointer to the progress bar structure (for the clock source
+ * and timer frequency).
  *
  * \return The current monotonic time in seconds.
  */
 double get_monotonic_time(const CPB_ProgressBar *restrict progress_bar);
 
+/**
+ * \brief Measure how long a single read of the clock of a progress bar takes.
+ *
+ * \param[in] progress_bar Pointer to the progress bar structure, after its clock
+ * source is resolved.
+ *
+ * \return The cost of a clock read in seconds, always positive.
+ */
+double measure_clock_read_cost(const CPB_ProgressBar *restrict progress_bar);
+
+/**
+ * \brief Open a separate non-blocking file descriptor writing to the given stream.
+ *
+ * A new open file description is used so that the blocking mode of the stream,
+ * which is shared with other processes writing to the same terminal, is untouched.
+ * Regular files never block and are not reopened.
+ *
+ * \param[in] stream The output stream (e.g., stdout).
+ * \return The file descriptor, or -1 if the stream cannot be reopened.
+ */
+int open_nonblocking_output(FILE *stream);
+
+/**
+ * \brief Write as much of a buffer as possible without blocking.
+ *
+ * \param[in] fd The non-blocking file descriptor.
+ * \param[in] data The data to write.
+ * \param[in] length The number of bytes to write.
+ * \return The number of bytes written, 0 if the write would block, or -1 on error.
+ */
+int64_t write_nonblocking(int fd, const char *data, size_t length);
+
+/**
+ * \brief Block until the file descriptor can accept more data.
+ *
+ * \param[in] fd The non-blocking file descriptor.
+ */
+void wait_until_writable(int fd);
+
+/**
+ * \brief Close a file descriptor returned by open_nonblocking_output.
+ *
+ * \param[in] fd The file descriptor.
+ */
+void close_nonblocking_output(int fd);
+
+/**
+ * \brief Create a non-blocking periodic timer file descriptor (Linux timerfd).
+ *
+ * \param[in] interval The timer period in seconds.
+ * \return The file descriptor, or -1 if timerfd is not available.
+ */
+int create_timer_fd(double interval);
+
+/**
+ * \brief Change the period of a timer file descriptor, restarting it.
+ *
+ * \param[in] fd The timer file descriptor.
+ * \param[in] interval The new timer period in seconds.
+ * \return true on success, false otherwise.
+ */
+bool set_timer_fd_interval(int fd, double interval);
+
+/**
+ * \brief Consume all pending expirations of a timer file descriptor.
+ *
+ * \param[in] fd The timer file descriptor.
+ */
+void drain_timer_fd(int fd);
+
+/**
+ * \brief Close a timer file descriptor returned by create_timer_fd.
+ *
+ * \param[in] fd The timer file descriptor.
+ */
+void close_timer_fd(int fd);
+
+/**
+ * \brief Get the CPU time used by the process so far, in user and kernel mode.
+ *
+ * \return The CPU time in seconds, or a negative value if not available.
+ */
+double get_process_cpu_time(void);
+
+/**
+ * \brief Get the resident set size of the process.
+ *
+ * \return The resident set size in bytes, or -1 if not available.
+ */
+int64_t get_process_rss(void);
+
+/**
+ * \brief Get the number of bytes the process read and wrote so far.
+ *
+ * On Linux, these are read_bytes and write_bytes from /proc/self/io, i.e. the
+ * storage I/O of the process.
+ *
+ * \param[out] read_bytes Output for the number of bytes read.
+ * \param[out] write_bytes Output for the number of bytes written.
+ * \return true if the counters are available.
+ */
+bool get_process_io(int64_t *restrict read_bytes, int64_t *restrict write_bytes);
+
 #endif /* C_PROGRESS_BAR_INTERNAL_SYSTEM_UTILS_H */
@@ -0,0 +1,48 @@
+/**
+ * \file thread_utils.h
+ * \brief Threading utility functions for C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#ifndef C_PROGRESS_BAR_INTERNAL_THREAD_UTILS_H
+#define C_PROGRESS_BAR_INTERNAL_THREAD_UTILS_H
+
+typedef struct PeriodicThread PeriodicThread;
+
+/**
+ * \brief Start a background thread that calls a function periodically.
+ *
+ * The function is always called with the thread's lock held, so callers can
+ * share state with it by taking the same lock through periodic_thread_lock.
+ *
+ * \param[in] tick The function to call.
+ * \param[in] arg The argument passed to the function.
+ * \param[in] interval The interval between calls in seconds.
+ *
+ * \return The thread handle, or NULL if the thread could not be started.
+ */
+PeriodicThread *periodic_thread_start(void (*tick)(void *), void *arg, double interval);
+
+/**
+ * \brief Stop a periodic thread, wait for it to exit and release its resources.
+ *
+ * \param[in] thread The thread to stop. Must not be locked by the caller.
+ */
+void periodic_thread_stop(PeriodicThread *thread);
+
+/**
+ * \brief Acquire the lock shared with the periodic thread.
+ *
+ * \param[in] thread The periodic thread.
+ */
+void periodic_thread_lock(PeriodicThread *thread);
+
+/**
+ * \brief Release the lock shared with the periodic thread.
+ *
+ * \param[in] thread The periodic thread.
+ */
+void periodic_thread_unlock(PeriodicThread *thread);
+
+#endif /* C_PROGRESS_BAR_INTERNAL_THREAD_UTILS_H */
@@ -8,13 +8,42 @@
 #include <stdint.h>
 
 #include "c_progress_bar.h"
+#include "internal/atomic_utils.h"
 #include "internal/math_utils.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ * \brief Helper function to get the index of the highest set bit.
+ *
+ * \param[in] value The value, must not be 0.
+ * \return floor(log2(value)).
+ */
+static int floor_log2(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    int result = 0;
+    while (value >>= 1)
+    {
+        result++;
+    }
+    return result;
+#endif
+}
+
 double calculate_percentage(const CPB_ProgressBar *restrict progress_bar)
 {
     const int64_t start = progress_bar->start;
-    const int64_t total = progress_bar->total - start;
-    const int64_t current = progress_bar->current - start;
+    const int64_t total = atomic_load_i64(&progress_bar->total) - start;
+    const int64_t current = atomic_load_i64(&progress_bar->current) - start;
 
     if (total <= 0 || current <= 0)
     {
@@ -40,7 +69,11 @@ double calculate_overall_rate(const CPB_ProgressBar *restrict progress_bar)
         return 0.0;
     }
 
-    return (double)progress_bar->internal.timer_percentage_last_update / elapsed_time;
+    // Progress made before the timer started (e.g. when attaching to a running job)
+    // does not count towards the rate
+    const double percentage = progress_bar->internal.timer_percentage_last_update -
+                              progress_bar->internal.timer_percentage_start;
+    return percentage / elapsed_time;
 }
 
 double calculate_recent_rate(const CPB_ProgressBar *restrict progress_bar)
@@ -66,4 +99,224 @@ double calculate_recent_rate(const CPB_ProgressBar *restrict progress_bar)
     }
 
     return sum_percent / sum_time;
-}
\ No newline at end of file
+}
+/**
+ * \brief Helper function to blend the recent and overall rates.
+ */
+static double blend_rates(
+    const CPB_ProgressBar *restrict progress_bar,
+    double recent_rate,
+    double overall_rate
+)
+{
+    const double recent_weight =
+        progress_bar->config.timer_remaining_time_recent_weight;
+    return recent_weight * recent_rate + (1.0 - recent_weight) * overall_rate;
+}
+
+double calculate_overall_item_rate(const CPB_ProgressBar *restrict progress_bar)
+{
+    const double elapsed_time =
+        (progress_bar->internal.timer_time_last_update -
+         progress_bar->internal.time_start);
+    if (elapsed_time <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return (double)(progress_bar->internal.timer_current_last_update -
+                    progress_bar->internal.timer_current_start) /
+           elapsed_time;
+}
+
+double calculate_recent_item_rate(const CPB_ProgressBar *restrict progress_bar)
+{
+    // We don't need recent rate anyways if we only have a few data points
+    if (progress_bar->internal.updates_count <= CPB_TIMER_DATA_POINTS)
+    {
+        return calculate_overall_item_rate(progress_bar);
+    }
+
+    double sum_time = 0.0;
+    double sum_items = 0.0;
+    for (int i = 0; i < CPB_TIMER_DATA_POINTS; i++)
+    {
+        sum_time += progress_bar->internal.timer_time_diffs[i];
+        sum_items += progress_bar->internal.timer_current_diffs[i];
+    }
+
+    if (sum_time <= 1e-9)
+    {
+        return calculate_overall_item_rate(progress_bar);
+    }
+
+    return sum_items / sum_time;
+}
+
+double calculate_item_rate(const CPB_ProgressBar *restrict progress_bar)
+{
+    return blend_rates(
+        progress_bar,
+        calculate_recent_item_rate(progress_bar),
+        calculate_overall_item_rate(progress_bar)
+    );
+}
+
+/**
+ * \brief Helper function to calculate how fast the total grew over the recent
+ * refresh ticks, in items per second.
+ *
+ * Unlike the completion rate, this is not blended with the overall rate. Work is
+ * often discovered in bursts, and an old burst says nothing about the growth to come.
+ */
+static double calculate_recent_growth_rate(const CPB_ProgressBar *restrict progress_bar)
+{
+    double sum_time = 0.0;
+    double sum_items = 0.0;
+    for (int i = 0; i < CPB_TIMER_DATA_POINTS; i++)
+    {
+        sum_time += progress_bar->internal.timer_time_diffs[i];
+        sum_items += progress_bar->internal.timer_total_diffs[i];
+    }
+
+    return sum_time > 1e-9 ? sum_items / sum_time : 0.0;
+}
+
+/**
+ * \brief Helper function to calculate the remaining time from item rates when the
+ * total grows.
+ */
+static double calculate_remaining_time_with_growth(
+    const CPB_ProgressBar *restrict progress_bar
+)
+{
+    const int64_t current = progress_bar->internal.timer_current_last_update;
+    const int64_t total = progress_bar->internal.timer_total_last_update;
+
+    // Once the total stops growing, this is the plain estimate in items
+    const double completion_rate = calculate_item_rate(progress_bar);
+    const double growth_rate = calculate_recent_growth_rate(progress_bar);
+    const double net_rate =
+        growth_rate > 0.0 ? completion_rate - growth_rate : completion_rate;
+
+    // Work is discovered at least as fast as it is completed
+    if (net_rate <= 0.0)
+    {
+        return -1.0;
+    }
+
+    return (double)(total - current) / net_rate;
+}
+
+double calculate_remaining_time(const CPB_ProgressBar *restrict progress_bar)
+{
+    if (progress_bar->is_finished)
+    {
+        return progress_bar->internal._is_aborted ? -1.0 : 0.0;
+    }
+
+    // A pipeline cannot finish faster than its slowest stage
+    if (progress_bar->internal.bottleneck_rate > 0.0)
+    {
+        return (double)(progress_bar->internal.timer_total_last_update -
+                        progress_bar->internal.timer_current_last_update) /
+               progress_bar->internal.bottleneck_rate;
+    }
+
+    if (progress_bar->internal.timer_total_last_update !=
+        progress_bar->internal.timer_total_start)
+    {
+        return calculate_remaining_time_with_growth(progress_bar);
+    }
+
+    const double blended_rate = blend_rates(
+        progress_bar,
+        calculate_recent_rate(progress_bar),
+        calculate_overall_rate(progress_bar)
+    );
+    if (blended_rate <= 0.0)
+    {
+        return -1.0;
+    }
+
+    const double remaining_percentage =
+        100.0 - progress_bar->internal.timer_percentage_last_update;
+    return remaining_percentage / blended_rate;
+}
+
+int calculate_latency_bucket(uint64_t nanoseconds)
+{
+    if (nanoseconds < CPB_LATENCY_SUB_BUCKETS)
+    {
+        return (int)nanoseconds;
+    }
+
+    // CPB_LATENCY_SUB_BUCKETS is 2^4, so the top 5 bits select the sub-bucket
+    const int octave = floor_log2(nanoseconds) - 4;
+    if (octave >= CPB_LATENCY_OCTAVES)
+    {
+        return CPB_LATENCY_BUCKETS - 1;
+    }
+
+    const int sub_bucket = (int)(nanoseconds >> octave) - CPB_LATENCY_SUB_BUCKETS;
+    return CPB_LATENCY_SUB_BUCKETS * (octave + 1) + sub_bucket;
+}
+
+uint64_t calculate_latency_bucket_lower_bound(int bucket)
+{
+    if (bucket < CPB_LATENCY_SUB_BUCKETS)
+    {
+        return (uint64_t)bucket;
+    }
+
+    const int octave = bucket / CPB_LATENCY_SUB_BUCKETS - 1;
+    const int sub_bucket = bucket % CPB_LATENCY_SUB_BUCKETS;
+    return (uint64_t)(CPB_LATENCY_SUB_BUCKETS + sub_bucket) << octave;
+}
+
+double calculate_latency_percentile(
+    const CPB_ProgressBar *restrict progress_bar,
+    double percentile
+)
+{
+    const int64_t count = progress_bar->internal.latency_count;
+    if (count <= 0)
+    {
+        return 0.0;
+    }
+
+    int64_t rank = (int64_t)(percentile / 100.0 * (double)count + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    if (rank >= count)
+    {
+        return progress_bar->internal.latency_max;
+    }
+
+    int64_t seen = 0;
+    int bucket = 0;
+    for (; bucket < CPB_LATENCY_BUCKETS - 1; bucket++)
+    {
+        seen += progress_bar->internal.latency_buckets[bucket];
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+
+    // Report the middle of the bucket, clamped to the observed range
+    const uint64_t lower = calculate_latency_bucket_lower_bound(bucket);
+    const uint64_t upper = calculate_latency_bucket_lower_bound(bucket + 1);
+    double value = (double)(lower + upper) * 0.5e-9;
+    if (value < progress_bar->internal.latency_min)
+    {
+        value = progress_bar->internal.latency_min;
+    }
+    if (value > progress_bar->internal.latency_max)
+    {
+        value = progress_bar->internal.latency_max;
+    }
+    return value;
+}
@@ -0,0 +1,366 @@
+/**
+ * \file pipeline.c
+ * \brief Multi-stage pipeline view for C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "c_progress_bar.h"
+#include "internal/atomic_utils.h"
+#include "internal/frame_buffer.h"
+#include "internal/progress_bar.h"
+#include "internal/thread_utils.h"
+
+#define PIPELINE_ERASE_LINE "\033[2K"
+#define PIPELINE_COLOR_BOTTLENECK "\033[0;31m"
+#define PIPELINE_RESET "\033[0m"
+
+// A stage is only held back by itself once it runs clearly slower than its feed
+#define PIPELINE_BOTTLENECK_RATIO 0.75
+
+static void update_stage_rates(CPB_Pipeline *restrict pipeline);
+static void render_stage(
+    const CPB_Pipeline *restrict pipeline,
+    int stage,
+    FrameBuffer *restrict frame_buffer
+);
+static size_t render_pipeline(void *context, FrameBuffer *restrict frame_buffer);
+static void print_pipeline(CPB_Pipeline *restrict pipeline);
+static void refresher_tick(void *arg);
+
+void cpb_pipeline_init(
+    CPB_Pipeline *restrict pipeline,
+    int64_t total,
+    CPB_Config config
+)
+{
+    if (!pipeline)
+    {
+        return;
+    }
+
+    cpb_init(&pipeline->progress_bar, 0, total, config);
+    pipeline->stage_count = 0;
+    pipeline->internal.bottleneck = -1;
+    pipeline->internal.last_refresh_time = 0.0;
+    pipeline->internal.has_drawn = false;
+    pipeline->internal._refresher = NULL;
+}
+
+int cpb_pipeline_add_stage(CPB_Pipeline *restrict pipeline, const char *restrict name)
+{
+    if (!pipeline || pipeline->stage_count >= CPB_PIPELINE_MAX_STAGES)
+    {
+        return -1;
+    }
+
+    const int stage = pipeline->stage_count++;
+    CPB_PipelineStage *pipeline_stage = &pipeline->stages[stage];
+    snprintf(
+        pipeline_stage->name, sizeof(pipeline_stage->name), "%s", name ? name : ""
+    );
+    pipeline_stage->count = 0;
+    pipeline_stage->queue_depth = -1;
+    pipeline_stage->last_count = 0;
+    pipeline_stage->rate = 0.0;
+    pipeline_stage->finish_time = 0.0;
+    return stage;
+}
+
+void cpb_pipeline_start(CPB_Pipeline *restrict pipeline)
+{
+    if (!pipeline || pipeline->stage_count == 0)
+    {
+        return;
+    }
+
+    // The end-to-end bar is driven from the refresh thread instead of cpb_start
+    CPB_ProgressBar *progress_bar = &pipeline->progress_bar;
+    open_output(progress_bar);
+    progress_bar->is_started = true;
+    update_timer_data(progress_bar);
+    pipeline->internal.last_refresh_time = progress_bar->internal.time_start;
+    print_pipeline(pipeline);
+
+    double interval = progress_bar->config.min_refresh_time;
+    if (interval < 0.05)
+    {
+        interval = 0.05;
+    }
+    pipeline->internal._refresher =
+        periodic_thread_start(refresher_tick, pipeline, interval);
+}
+
+void cpb_pipeline_update(CPB_Pipeline *restrict pipeline, int stage, int64_t count)
+{
+    if (!pipeline || stage < 0 || stage >= pipeline->stage_count)
+    {
+        return;
+    }
+
+    atomic_store_i64(&pipeline->stages[stage].count, count);
+}
+
+void cpb_pipeline_add(CPB_Pipeline *restrict pipeline, int stage, int64_t amount)
+{
+    if (!pipeline || stage < 0 || stage >= pipeline->stage_count)
+    {
+        return;
+    }
+
+    atomic_fetch_add_i64(&pipeline->stages[stage].count, amount);
+}
+
+void cpb_pipeline_set_queue_depth(
+    CPB_Pipeline *restrict pipeline,
+    int stage,
+    int64_t queue_depth
+)
+{
+    if (!pipeline || stage < 0 || stage >= pipeline->stage_count)
+    {
+        return;
+    }
+
+    atomic_store_i64(&pipeline->stages[stage].queue_depth, queue_depth);
+}
+
+void cpb_pipeline_finish(CPB_Pipeline *restrict pipeline)
+{
+    if (!pipeline || pipeline->stage_count == 0)
+    {
+        return;
+    }
+
+    if (pipeline->internal._refresher)
+    {
+        periodic_thread_stop(pipeline->internal._refresher);
+        pipeline->internal._refresher = NULL;
+    }
+
+    CPB_ProgressBar *progress_bar = &pipeline->progress_bar;
+    atomic_store_i64(
+        &progress_bar->current,
+        atomic_load_i64(&pipeline->stages[pipeline->stage_count - 1].count)
+    );
+    progress_bar->is_finished = true;
+    update_timer_data(progress_bar);
+    update_stage_rates(pipeline);
+    print_pipeline(pipeline);
+    close_output(progress_bar);
+}
+
+/**
+ * \brief Helper function to update the rate of every stage and find the bottleneck.
+ *
+ * Rates are blended like the rate of a progress bar. Once a stage is done, it shows
+ * its average rate until then instead, so that the final view shows which stage
+ * held the pipeline back.
+ *
+ * A stage never gets ahead of the stage feeding it, so the stages after the
+ * bottleneck trail it at about the same rate. The bottleneck is thus the stage
+ * whose rate drops clearly below that of its upstream stage, or the first stage if
+ * every stage keeps up with its feed.
+ */
+static void update_stage_rates(CPB_Pipeline *restrict pipeline)
+{
+    CPB_ProgressBar *progress_bar = &pipeline->progress_bar;
+    const double current_time = progress_bar->internal.timer_time_last_update;
+    const double elapsed_time = current_time - progress_bar->internal.time_start;
+    const double diff_time = current_time - pipeline->internal.last_refresh_time;
+    pipeline->internal.last_refresh_time = current_time;
+    if (elapsed_time <= 0.0 || diff_time <= 0.0)
+    {
+        return;
+    }
+
+    double recent_weight = progress_bar->config.timer_remaining_time_recent_weight;
+    if (recent_weight < 0.0)
+    {
+        recent_weight = 0.0;
+    }
+    else if (recent_weight > 1.0)
+    {
+        recent_weight = 1.0;
+    }
+
+    const int64_t total = atomic_load_i64(&progress_bar->total);
+    for (int i = 0; i < pipeline->stage_count; i++)
+    {
+        CPB_PipelineStage *stage = &pipeline->stages[i];
+        const int64_t count = atomic_load_i64(&stage->count);
+        if (stage->finish_time <= 0.0 && count >= total)
+        {
+            stage->finish_time = elapsed_time;
+        }
+
+        if (stage->finish_time > 0.0)
+        {
+            stage->rate = (double)count / stage->finish_time;
+        }
+        else if (progress_bar->is_finished)
+        {
+            stage->rate = (double)count / elapsed_time;
+        }
+        else
+        {
+            const double recent_rate = (double)(count - stage->last_count) / diff_time;
+            const double overall_rate = (double)count / elapsed_time;
+            stage->rate =
+                recent_weight * recent_rate + (1.0 - recent_weight) * overall_rate;
+        }
+        stage->last_count = count;
+    }
+
+    // Done stages no longer hold anything back, unless the whole pipeline is done.
+    // Of several drops, the slowest of those stages limits the end-to-end rate.
+    int bottleneck = -1;
+    bool has_drop = false;
+    for (int i = 0; i < pipeline->stage_count; i++)
+    {
+        const CPB_PipelineStage *stage = &pipeline->stages[i];
+        if (!progress_bar->is_finished && stage->finish_time > 0.0)
+        {
+            continue;
+        }
+
+        const double upstream_rate = i > 0 ? pipeline->stages[i - 1].rate : 0.0;
+        const bool is_drop = stage->rate < PIPELINE_BOTTLENECK_RATIO * upstream_rate;
+        if (bottleneck < 0 ||
+            (is_drop && (!has_drop || stage->rate < pipeline->stages[bottleneck].rate)))
+        {
+            bottleneck = i;
+            has_drop = is_drop;
+        }
+    }
+
+    pipeline->internal.bottleneck = bottleneck;
+    progress_bar->internal.bottleneck_rate =
+        bottleneck >= 0 ? pipeline->stages[bottleneck].rate : 0.0;
+}
+
+static void render_stage(
+    const CPB_Pipeline *restrict pipeline,
+    int stage,
+    FrameBuffer *restrict frame_buffer
+)
+{
+    const bool is_utf8 = pipeline->progress_bar.internal._is_utf8;
+    const bool is_bottleneck = stage == pipeline->internal.bottleneck;
+    const CPB_PipelineStage *pipeline_stage = &pipeline->stages[stage];
+
+    int name_width = 0;
+    for (int i = 0; i < pipeline->stage_count; i++)
+    {
+        const int length = (int)strlen(pipeline->stages[i].name);
+        name_width = length > name_width ? length : name_width;
+    }
+
+    char rate_buffer[32];
+    FrameBuffer rate;
+    frame_buffer_init(&rate, rate_buffer, sizeof(rate_buffer));
+    frame_buffer_print_rate(&rate, pipeline_stage->rate);
+
+    frame_buffer_puts(frame_buffer, "\r");
+    if (is_utf8)
+    {
+        frame_buffer_puts(frame_buffer, PIPELINE_ERASE_LINE);
+        if (is_bottleneck)
+        {
+            frame_buffer_puts(frame_buffer, PIPELINE_COLOR_BOTTLENECK);
+        }
+    }
+    frame_buffer_printf(
+        frame_buffer,
+        "  %-*s %12lld %12s",
+        name_width,
+        pipeline_stage->name,
+        (long long)atomic_load_i64(&pipeline_stage->count),
+        rate.data
+    );
+
+    const int64_t queue_depth = atomic_load_i64(&pipeline_stage->queue_depth);
+    if (queue_depth >= 0)
+    {
+        frame_buffer_printf(frame_buffer, "  queue %lld", (long long)queue_depth);
+    }
+    if (is_bottleneck)
+    {
+        frame_buffer_puts(frame_buffer, "  <- bottleneck");
+    }
+    if (is_utf8 && is_bottleneck)
+    {
+        frame_buffer_puts(frame_buffer, PIPELINE_RESET);
+    }
+    frame_buffer_puts(frame_buffer, "\n");
+}
+
+static size_t render_pipeline(void *context, FrameBuffer *restrict frame_buffer)
+{
+    CPB_Pipeline *pipeline = context;
+    const CPB_ProgressBar *progress_bar = &pipeline->progress_bar;
+
+    size_t line_start;
+    if (progress_bar->internal._is_utf8)
+    {
+        // Redraw the whole view in place, starting from the first stage line
+        if (pipeline->internal.has_drawn)
+        {
+            frame_buffer_printf(frame_buffer, "\r\033[%dA", pipeline->stage_count);
+        }
+        for (int i = 0; i < pipeline->stage_count; i++)
+        {
+            render_stage(pipeline, i, frame_buffer);
+        }
+        line_start = render_progress_bar(progress_bar, frame_buffer);
+    }
+    else
+    {
+        // Without cursor movement, the stage lines are printed once at the end
+        line_start = render_progress_bar(progress_bar, frame_buffer);
+        if (progress_bar->is_finished)
+        {
+            for (int i = 0; i < pipeline->stage_count; i++)
+            {
+                render_stage(pipeline, i, frame_buffer);
+            }
+        }
+    }
+    pipeline->internal.has_drawn = true;
+
+    return line_start;
+}
+
+static void print_pipeline(CPB_Pipeline *restrict pipeline)
+{
+    CPB_ProgressBar *progress_bar = &pipeline->progress_bar;
+    if (progress_bar->config.headless)
+    {
+        return;
+    }
+    sample_resources(progress_bar);
+
+    // Shares the output of the bar, so non-blocking output and log lines apply
+    write_frame(progress_bar, render_pipeline, pipeline);
+}
+
+static void refresher_tick(void *arg)
+{
+    CPB_Pipeline *pipeline = arg;
+    CPB_ProgressBar *progress_bar = &pipeline->progress_bar;
+    atomic_store_i64(
+        &progress_bar->current,
+        atomic_load_i64(&pipeline->stages[pipeline->stage_count - 1].count)
+    );
+    if (update_timer_data(progress_bar))
+    {
+        update_stage_rates(pipeline);
+        print_pipeline(pipeline);
+    }
+}
@@ -0,0 +1,212 @@
+/**
+ * \file process_source.c
+ * \brief Progress of other processes sampled from /proc for C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "c_progress_bar.h"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * \brief Helper function to read a "key: value" field from a /proc file.
+ *
+ * \param[in] path The path of the file.
+ * \param[in] key The key including the colon, e.g. "pos:".
+ * \param[out] value Output for the value.
+ * \return true if the field was found, false otherwise.
+ */
+static bool read_proc_field(const char *path, const char *key, int64_t *value)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    const size_t key_length = strlen(key);
+    bool is_found = false;
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        if (strncmp(line, key, key_length) == 0)
+        {
+            *value = (int64_t)strtoll(line + key_length, NULL, 10);
+            is_found = true;
+            break;
+        }
+    }
+
+    fclose(file);
+    return is_found;
+}
+
+/**
+ * \brief Helper function to get the size of the file behind a file descriptor.
+ *
+ * \param[in] pid The process owning the file descriptor.
+ * \param[in] fd The file descriptor.
+ * \return The size of the file, or -1 if it is not a regular file.
+ */
+static int64_t get_fd_file_size(int pid, int fd)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", pid, fd);
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return -1;
+    }
+    return (int64_t)st.st_size;
+}
+
+/**
+ * \brief Helper function to find the largest regular file opened by a process.
+ *
+ * \param[in] pid The process.
+ * \return The file descriptor, or -1 if there is none.
+ */
+static int find_largest_fd(int pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        return -1;
+    }
+
+    int largest_fd = -1;
+    int64_t largest_size = -1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+        {
+            continue;
+        }
+
+        const int fd = atoi(entry->d_name);
+        const int64_t size = get_fd_file_size(pid, fd);
+        if (size > largest_size)
+        {
+            largest_fd = fd;
+            largest_size = size;
+        }
+    }
+
+    closedir(dir);
+    return largest_fd;
+}
+#endif /* __linux__ */
+
+bool cpb_process_source_init(
+    CPB_ProcessSource *restrict source,
+    int pid,
+    int fd,
+    CPB_ProcessCounter counter
+)
+{
+    if (!source)
+    {
+        return false;
+    }
+
+    source->pid = pid;
+    source->fd = fd;
+    source->counter = counter;
+    source->total = 0;
+    source->name[0] = '\0';
+
+#ifdef __linux__
+    char path[64];
+    if (counter != CPB_PROCESS_FD_POSITION)
+    {
+        // Name the source after the process
+        snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+        FILE *file = fopen(path, "r");
+        if (!file)
+        {
+            return false;
+        }
+        if (fgets(source->name, sizeof(source->name), file))
+        {
+            source->name[strcspn(source->name, "\n")] = '\0';
+        }
+        fclose(file);
+        return true;
+    }
+
+    if (fd < 0)
+    {
+        source->fd = find_largest_fd(pid);
+        if (source->fd < 0)
+        {
+            return false;
+        }
+    }
+
+    const int64_t size = get_fd_file_size(pid, source->fd);
+    if (size < 0)
+    {
+        return false;
+    }
+    source->total = size;
+
+    // Name the source after the file
+    snprintf(path, sizeof(path), "/proc/%d/fd/%d", pid, source->fd);
+    const ssize_t length = readlink(path, source->name, sizeof(source->name) - 1);
+    if (length > 0)
+    {
+        source->name[length] = '\0';
+    }
+    return true;
+#else
+    return false;
+#endif /* __linux__ */
+}
+
+bool cpb_process_source_sample(
+    const CPB_ProcessSource *restrict source,
+    int64_t *restrict current
+)
+{
+    if (!source || !current)
+    {
+        return false;
+    }
+
+#ifdef __linux__
+    char path[64];
+    switch (source->counter)
+    {
+        case CPB_PROCESS_FD_POSITION:
+            snprintf(path, sizeof(path), "/proc/%d/fdinfo/%d", source->pid, source->fd);
+            return read_proc_field(path, "pos:", current);
+
+        case CPB_PROCESS_READ_BYTES:
+            snprintf(path, sizeof(path), "/proc/%d/io", source->pid);
+            return read_proc_field(path, "rchar:", current);
+
+        case CPB_PROCESS_WRITE_BYTES:
+            snprintf(path, sizeof(path), "/proc/%d/io", source->pid);
+            return read_proc_field(path, "wchar:", current);
+
+        default:
+            return false;
+    }
+#else
+    return false;
+#endif /* __linux__ */
+}
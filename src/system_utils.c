@@ -6,7 +6,9 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,17 +19,37 @@
 #ifdef _WIN32
 #include <io.h>
 #include <windows.h>
+#include <psapi.h>
 #define ISATTY _isatty
 #define FILENO _fileno
 #else
+#include <fcntl.h>
 #include <langinfo.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
 #define ISATTY isatty
 #define FILENO fileno
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPB_HAS_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#else
+#define CPB_HAS_TSC 0
+#endif
+
 /**
  * \brief Helper function to search for UTF-8 indicators in a string.
  *
@@ -210,32 +232,447 @@ int get_terminal_width(FILE *stream)
     return CPB_DEFAULT_TERMINAL_WIDTH;
 }
 
-double get_timer_freq_inv(void)
+#if CPB_HAS_TSC
+/**
+ * \brief Helper function to determine if the TSC ticks at a constant rate.
+ *
+ * \return true if the CPU reports an invariant TSC, false otherwise.
+ */
+static bool cpu_has_invariant_tsc(void)
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000007u)
+    {
+        return false;
+    }
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+    {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+#endif /* _MSC_VER */
+}
+#endif /* CPB_HAS_TSC */
+
+/**
+ * \brief Helper function to read the default monotonic clock in seconds.
+ *
+ * \param[in] timer_freq_inv The inverse of the timer frequency (for Windows).
+ * \return The current monotonic time in seconds.
+ */
+static double read_default_monotonic_time(double timer_freq_inv)
+{
+#ifdef _WIN32
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * timer_freq_inv;
+#else
+    (void)timer_freq_inv;
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    {
+        // Never return a constant, as that would silently break the ETA
+        if (clock_gettime(CLOCK_REALTIME, &ts) != 0)
+        {
+            return (double)time(NULL);
+        }
+    }
+
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+#endif /* _WIN32 */
+}
+
+CPB_ClockSource resolve_clock_source(const CPB_Config *restrict config)
+{
+    switch (config->clock_source)
+    {
+        case CPB_CLOCK_MONOTONIC_COARSE:
+        {
+#if defined(_WIN32)
+            return CPB_CLOCK_MONOTONIC_COARSE;
+#elif defined(CLOCK_MONOTONIC_COARSE)
+            struct timespec ts;
+            if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+            {
+                return CPB_CLOCK_MONOTONIC_COARSE;
+            }
+            return CPB_CLOCK_MONOTONIC;
+#else
+            return CPB_CLOCK_MONOTONIC;
+#endif
+        }
+
+        case CPB_CLOCK_TSC:
+#if CPB_HAS_TSC
+            return cpu_has_invariant_tsc() ? CPB_CLOCK_TSC : CPB_CLOCK_MONOTONIC;
+#else
+            return CPB_CLOCK_MONOTONIC;
+#endif /* CPB_HAS_TSC */
+
+        case CPB_CLOCK_USER:
+            return config->clock_function ? CPB_CLOCK_USER : CPB_CLOCK_MONOTONIC;
+
+        case CPB_CLOCK_MONOTONIC:
+        default:
+            return CPB_CLOCK_MONOTONIC;
+    }
+}
+
+double get_timer_freq_inv(CPB_ClockSource clock_source)
 {
 #ifdef _WIN32
     LARGE_INTEGER freq;
     QueryPerformanceFrequency(&freq);
-    return 1.0 / (double)freq.QuadPart;
+    const double monotonic_freq_inv = 1.0 / (double)freq.QuadPart;
 #else
-    return 1.0;
+    const double monotonic_freq_inv = 1.0;
 #endif /* _WIN32 */
+
+#if CPB_HAS_TSC
+    if (clock_source == CPB_CLOCK_TSC)
+    {
+        // Count TSC ticks over a short interval of the monotonic clock
+        const double calibration_time = 0.005;
+        const double time_begin = read_default_monotonic_time(monotonic_freq_inv);
+        const unsigned long long tsc_begin = __rdtsc();
+
+        double time_end = time_begin;
+        while (time_end - time_begin < calibration_time)
+        {
+            time_end = read_default_monotonic_time(monotonic_freq_inv);
+        }
+        const unsigned long long tsc_end = __rdtsc();
+
+        return (time_end - time_begin) / (double)(tsc_end - tsc_begin);
+    }
+#else
+    (void)clock_source;
+#endif /* CPB_HAS_TSC */
+
+    return monotonic_freq_inv;
 }
 
 double get_monotonic_time(const CPB_ProgressBar *restrict progress_bar)
+{
+    switch (progress_bar->internal._clock_source)
+    {
+        case CPB_CLOCK_USER:
+            return progress_bar->config.clock_function(
+                progress_bar->config.clock_user_data
+            );
+
+#if CPB_HAS_TSC
+        case CPB_CLOCK_TSC:
+            return (double)__rdtsc() * progress_bar->internal._timer_freq_inv;
+#endif /* CPB_HAS_TSC */
+
+        case CPB_CLOCK_MONOTONIC_COARSE:
+        {
+#if defined(_WIN32)
+            return (double)GetTickCount64() / 1000.0;
+#elif defined(CLOCK_MONOTONIC_COARSE)
+            struct timespec ts;
+            if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+            {
+                return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+            }
+            break;
+#else
+            break;
+#endif
+        }
+
+        default:
+            break;
+    }
+
+    return read_default_monotonic_time(progress_bar->internal._timer_freq_inv);
+}
+
+double measure_clock_read_cost(const CPB_ProgressBar *restrict progress_bar)
+{
+    // Time the reads with the default clock, as a coarse or user clock may not even
+    // advance while they run
+    const double monotonic_freq_inv = get_timer_freq_inv(CPB_CLOCK_MONOTONIC);
+    const int reads = 64;
+    const double time_begin = read_default_monotonic_time(monotonic_freq_inv);
+    for (int i = 0; i < reads; i++)
+    {
+        get_monotonic_time(progress_bar);
+    }
+    const double time_end = read_default_monotonic_time(monotonic_freq_inv);
+
+    // A free clock would leave nothing to tune the stride against
+    const double cost = (time_end - time_begin) / reads;
+    return cost > 1e-9 ? cost : 1e-9;
+}
+
+int open_nonblocking_output(FILE *stream)
 {
 #ifdef _WIN32
-    LARGE_INTEGER now;
-    QueryPerformanceCounter(&now);
-    return (double)now.QuadPart * progress_bar->internal._timer_freq_inv;
+    (void)stream;
+    return -1;
+#else
+    const int fd = FILENO(stream);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || S_ISREG(st.st_mode))
+    {
+        return -1;
+    }
 
+    int flags = O_WRONLY | O_NONBLOCK | O_NOCTTY;
+#ifdef O_CLOEXEC
+    flags |= O_CLOEXEC;
+#endif
+
+    // Reopening through /proc also works for pipes, ttyname only for terminals
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    int output_fd = open(path, flags);
+    if (output_fd < 0 && ISATTY(fd))
+    {
+        const char *tty = ttyname(fd);
+        if (tty)
+        {
+            output_fd = open(tty, flags);
+        }
+    }
+
+    return output_fd;
+#endif /* _WIN32 */
+}
+
+int64_t write_nonblocking(int fd, const char *data, size_t length)
+{
+#ifdef _WIN32
+    (void)fd;
+    (void)data;
+    (void)length;
+    return -1;
 #else
-    (void)progress_bar;
-    struct timespec ts;
-    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+    for (;;)
     {
-        return 0.0;
+        const ssize_t written = write(fd, data, length);
+        if (written >= 0)
+        {
+            return (int64_t)written;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        return -1;
     }
+#endif /* _WIN32 */
+}
 
-    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+void wait_until_writable(int fd)
+{
+#ifdef _WIN32
+    (void)fd;
+#else
+    struct pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR)
+    {
+    }
+#endif /* _WIN32 */
+}
+
+void close_nonblocking_output(int fd)
+{
+#ifdef _WIN32
+    (void)fd;
+#else
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+#endif /* _WIN32 */
+}
+
+int create_timer_fd(double interval)
+{
+#ifdef __linux__
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (!set_timer_fd_interval(fd, interval))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+#else
+    (void)interval;
+    return -1;
+#endif /* __linux__ */
+}
+
+bool set_timer_fd_interval(int fd, double interval)
+{
+#ifdef __linux__
+    // A zero interval would disarm the timer
+    if (interval < 0.001)
+    {
+        interval = 0.001;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = (time_t)interval;
+    spec.it_interval.tv_nsec = (long)((interval - (double)(time_t)interval) * 1e9);
+    spec.it_value = spec.it_interval;
+    return timerfd_settime(fd, 0, &spec, NULL) == 0;
+#else
+    (void)fd;
+    (void)interval;
+    return false;
+#endif /* __linux__ */
+}
+
+void drain_timer_fd(int fd)
+{
+#ifdef __linux__
+    uint64_t expirations;
+    while (read(fd, &expirations, sizeof(expirations)) < 0 && errno == EINTR)
+    {
+    }
+#else
+    (void)fd;
+#endif /* __linux__ */
+}
+
+void close_timer_fd(int fd)
+{
+#ifdef __linux__
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+#else
+    (void)fd;
+#endif /* __linux__ */
+}
+
+double get_process_cpu_time(void)
+{
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (!GetProcessTimes(
+            GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time
+        ))
+    {
+        return -1.0;
+    }
+
+    // FILETIME counts in units of 100 ns
+    const ULONGLONG kernel =
+        ((ULONGLONG)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    const ULONGLONG user =
+        ((ULONGLONG)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+    return (double)(kernel + user) * 1e-7;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return -1.0;
+    }
+
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
 #endif /* _WIN32 */
-}
\ No newline at end of file
+}
+
+int64_t get_process_rss(void)
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return -1;
+    }
+
+    return (int64_t)counters.WorkingSetSize;
+#elif defined(__linux__)
+    // The second field is the number of resident pages
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file)
+    {
+        return -1;
+    }
+
+    long long size = 0;
+    long long resident = 0;
+    const int fields = fscanf(file, "%lld %lld", &size, &resident);
+    fclose(file);
+    if (fields != 2)
+    {
+        return -1;
+    }
+
+    return (int64_t)resident * (int64_t)sysconf(_SC_PAGESIZE);
+#else
+    // getrusage only reports the peak resident set size on other systems
+    return -1;
+#endif
+}
+
+bool get_process_io(int64_t *restrict read_bytes, int64_t *restrict write_bytes)
+{
+#if defined(_WIN32)
+    IO_COUNTERS counters;
+    if (!GetProcessIoCounters(GetCurrentProcess(), &counters))
+    {
+        return false;
+    }
+
+    *read_bytes = (int64_t)counters.ReadTransferCount;
+    *write_bytes = (int64_t)counters.WriteTransferCount;
+    return true;
+#elif defined(__linux__)
+    FILE *file = fopen("/proc/self/io", "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    // Bytes going to and from storage. Unlike rchar and wchar, these leave out the
+    // reads of /proc and the frames written to the terminal by the bar itself.
+    int found = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), file))
+    {
+        long long value = 0;
+        if (sscanf(line, "read_bytes: %lld", &value) == 1)
+        {
+            *read_bytes = (int64_t)value;
+            found++;
+        }
+        else if (sscanf(line, "write_bytes: %lld", &value) == 1)
+        {
+            *write_bytes = (int64_t)value;
+            found++;
+        }
+    }
+    fclose(file);
+
+    return found == 2;
+#else
+    (void)read_bytes;
+    (void)write_bytes;
+    return false;
+#endif
+}
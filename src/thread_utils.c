@@ -0,0 +1,192 @@
+/**
+ * \file thread_utils.c
+ * \brief Threading utility functions for C Progress Bar library.
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "internal/thread_utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+struct PeriodicThread
+{
+    void (*tick)(void *);
+    void *arg;
+    double interval;
+    bool should_stop;
+
+#ifdef _WIN32
+    HANDLE thread;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE wakeup;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+#endif /* _WIN32 */
+};
+
+#ifdef _WIN32
+static DWORD WINAPI periodic_thread_main(LPVOID param)
+{
+    PeriodicThread *thread = param;
+    const DWORD interval_ms = (DWORD)(thread->interval * 1000.0) + 1;
+
+    EnterCriticalSection(&thread->lock);
+    while (!thread->should_stop)
+    {
+        // Spurious wakeups only cause an early tick, which is harmless
+        SleepConditionVariableCS(&thread->wakeup, &thread->lock, interval_ms);
+        if (!thread->should_stop)
+        {
+            thread->tick(thread->arg);
+        }
+    }
+    LeaveCriticalSection(&thread->lock);
+    return 0;
+}
+#else
+/**
+ * \brief Add a number of seconds to a timespec.
+ */
+static struct timespec add_seconds(struct timespec ts, double seconds)
+{
+    const long long nsec = ts.tv_nsec + (long long)(seconds * 1e9);
+    ts.tv_sec += (time_t)(nsec / 1000000000LL);
+    ts.tv_nsec = (long)(nsec % 1000000000LL);
+    return ts;
+}
+
+static void *periodic_thread_main(void *param)
+{
+    PeriodicThread *thread = param;
+
+#ifdef __APPLE__
+    const clockid_t clock_id = CLOCK_REALTIME;
+#else
+    const clockid_t clock_id = CLOCK_MONOTONIC;
+#endif
+
+    struct timespec deadline;
+    clock_gettime(clock_id, &deadline);
+    deadline = add_seconds(deadline, thread->interval);
+
+    pthread_mutex_lock(&thread->lock);
+    while (!thread->should_stop)
+    {
+        if (pthread_cond_timedwait(&thread->wakeup, &thread->lock, &deadline) == 0)
+        {
+            continue;
+        }
+
+        thread->tick(thread->arg);
+        clock_gettime(clock_id, &deadline);
+        deadline = add_seconds(deadline, thread->interval);
+    }
+    pthread_mutex_unlock(&thread->lock);
+    return NULL;
+}
+#endif /* _WIN32 */
+
+PeriodicThread *periodic_thread_start(void (*tick)(void *), void *arg, double interval)
+{
+    PeriodicThread *thread = malloc(sizeof(PeriodicThread));
+    if (!thread)
+    {
+        return NULL;
+    }
+
+    thread->tick = tick;
+    thread->arg = arg;
+    thread->interval = interval;
+    thread->should_stop = false;
+
+#ifdef _WIN32
+    InitializeCriticalSection(&thread->lock);
+    InitializeConditionVariable(&thread->wakeup);
+    thread->thread = CreateThread(NULL, 0, periodic_thread_main, thread, 0, NULL);
+    if (!thread->thread)
+    {
+        DeleteCriticalSection(&thread->lock);
+        free(thread);
+        return NULL;
+    }
+#else
+    pthread_mutex_init(&thread->lock, NULL);
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+#ifndef __APPLE__
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&thread->wakeup, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    if (pthread_create(&thread->thread, NULL, periodic_thread_main, thread) != 0)
+    {
+        pthread_cond_destroy(&thread->wakeup);
+        pthread_mutex_destroy(&thread->lock);
+        free(thread);
+        return NULL;
+    }
+#endif /* _WIN32 */
+
+    return thread;
+}
+
+void periodic_thread_stop(PeriodicThread *thread)
+{
+    if (!thread)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    EnterCriticalSection(&thread->lock);
+    thread->should_stop = true;
+    WakeConditionVariable(&thread->wakeup);
+    LeaveCriticalSection(&thread->lock);
+
+    WaitForSingleObject(thread->thread, INFINITE);
+    CloseHandle(thread->thread);
+    DeleteCriticalSection(&thread->lock);
+#else
+    pthread_mutex_lock(&thread->lock);
+    thread->should_stop = true;
+    pthread_cond_signal(&thread->wakeup);
+    pthread_mutex_unlock(&thread->lock);
+
+    pthread_join(thread->thread, NULL);
+    pthread_cond_destroy(&thread->wakeup);
+    pthread_mutex_destroy(&thread->lock);
+#endif /* _WIN32 */
+
+    free(thread);
+}
+
+void periodic_thread_lock(PeriodicThread *thread)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&thread->lock);
+#else
+    pthread_mutex_lock(&thread->lock);
+#endif /* _WIN32 */
+}
+
+void periodic_thread_unlock(PeriodicThread *thread)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&thread->lock);
+#else
+    pthread_mutex_unlock(&thread->lock);
+#endif /* _WIN32 */
+}
@@ -0,0 +1,120 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "c_progress_bar.h"
+
+#define N 100
+
+static int stall_count = 0;
+static int rate_drop_count = 0;
+static int clear_count = 0;
+
+static void on_alert(CPB_ProgressBar *progress_bar, CPB_Alert alert, void *user_data)
+{
+    (void)progress_bar;
+    (void)user_data;
+    if (alert == CPB_ALERT_STALL)
+    {
+        stall_count++;
+    }
+    else if (alert == CPB_ALERT_RATE_DROP)
+    {
+        rate_drop_count++;
+    }
+    else if (alert == CPB_ALERT_NONE)
+    {
+        clear_count++;
+    }
+}
+
+static void busy_wait(double seconds)
+{
+    const clock_t start = clock();
+    while ((double)(clock() - start) / CLOCKS_PER_SEC < seconds)
+    {
+    }
+}
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+// Items are done at a steady 128 items/s for 64 s, then at slow_rate, while the
+// total grows by 256 items/s. Returns the number of rate drop alerts.
+static int run_growing_total(int64_t slow_rate)
+{
+    double fake_time = 100.0;
+    CPB_Config config = cpb_get_default_config();
+    config.min_refresh_time = 0.125;
+    config.rate_drop_threshold = 0.5;
+    config.rate_drop_window = 4.0;
+    config.on_alert = on_alert;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    config.headless = true;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, 1024, config);
+
+    rate_drop_count = 0;
+    cpb_start(&progress_bar);
+    int64_t current = 0;
+    for (int step = 1; step <= 128 * 8; step++)
+    {
+        fake_time += 1.0 / 8.0;
+        cpb_add_total(&progress_bar, 32);
+        current += step <= 64 * 8 ? 16 : slow_rate / 8;
+        cpb_update(&progress_bar, current);
+    }
+    cpb_finish(&progress_bar);
+
+    return rate_drop_count;
+}
+
+int main(void)
+{
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Alerts";
+    config.min_refresh_time = 0.01;
+    config.stall_timeout = 0.2;
+    config.on_alert = on_alert;
+    config.show_alerts = true;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    cpb_start(&progress_bar);
+    for (int64_t i = 0; i < N / 2; i++)
+    {
+        cpb_update(&progress_bar, i);
+    }
+
+    // No updates at all: only the watchdog can notice the stall
+    busy_wait(0.6);
+
+    for (int64_t i = N / 2; i <= N; i++)
+    {
+        busy_wait(0.001);
+        cpb_update(&progress_bar, i);
+    }
+    cpb_finish(&progress_bar);
+
+    printf("stalls=%d clears=%d\n", stall_count, clear_count);
+    if (stall_count != 1 || clear_count != 1)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // A growing total lowers the percentage rate, but is not a rate drop
+    const int steady_drops = run_growing_total(128);
+    const int slow_drops = run_growing_total(16);
+    printf("rate drops: steady=%d slow=%d\n", steady_drops, slow_drops);
+    if (steady_drops != 0 || slow_drops != 1)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "c_progress_bar.h"
+
+static void busy_wait(double seconds)
+{
+    const clock_t start = clock();
+    while ((double)(clock() - start) / CLOCKS_PER_SEC < seconds)
+    {
+    }
+}
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+int main(void)
+{
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Budget";
+    config.min_refresh_time = 0.02;
+    config.overhead_budget = 0.01;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, INT64_C(1) << 40, config);
+
+    // Cheap updates in a tight loop, so most of them skip the clock
+    cpb_start(&progress_bar);
+    int64_t current = 0;
+    const clock_t fast_end = clock() + CLOCKS_PER_SEC / 2;
+    while (clock() < fast_end)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            cpb_update(&progress_bar, ++current);
+        }
+    }
+    CPB_Stats fast_stats;
+    cpb_get_stats(&progress_bar, &fast_stats);
+
+    // Then the throughput collapses, which the bar must show within a few intervals
+    // even though the stride was tuned for the fast updates
+    for (int i = 0; i < 25; i++)
+    {
+        busy_wait(0.02);
+        cpb_update(&progress_bar, ++current);
+    }
+    CPB_Stats slow_stats;
+    cpb_get_stats(&progress_bar, &slow_stats);
+    cpb_finish(&progress_bar);
+
+    const int64_t slow_renders = slow_stats.renders - fast_stats.renders;
+    fprintf(
+        stderr,
+        "\nfast: stride=%lld renders=%lld, slow: stride=%lld renders=%lld\n",
+        (long long)fast_stats.check_stride,
+        (long long)fast_stats.renders,
+        (long long)slow_stats.check_stride,
+        (long long)slow_renders
+    );
+
+    if (fast_stats.check_stride <= 25 || slow_stats.check_stride >= 25)
+    {
+        return EXIT_FAILURE;
+    }
+    if (slow_renders < 5)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Clocks that do not advance while being read still have a cost to tune against
+    double fake_time = 100.0;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    cpb_init(&progress_bar, 0, 1, config);
+    const double user_cost = progress_bar.internal._clock_read_cost;
+
+    config.clock_source = CPB_CLOCK_MONOTONIC_COARSE;
+    cpb_init(&progress_bar, 0, INT64_C(1) << 40, config);
+    const double coarse_cost = progress_bar.internal._clock_read_cost;
+    cpb_start(&progress_bar);
+    current = 0;
+    const clock_t coarse_end = clock() + CLOCKS_PER_SEC / 4;
+    while (clock() < coarse_end)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            cpb_update(&progress_bar, ++current);
+        }
+    }
+    CPB_Stats coarse_stats;
+    cpb_get_stats(&progress_bar, &coarse_stats);
+    cpb_finish(&progress_bar);
+
+    fprintf(
+        stderr,
+        "user clock: %g s/read, coarse clock: %g s/read, stride=%lld\n",
+        user_cost,
+        coarse_cost,
+        (long long)coarse_stats.check_stride
+    );
+    if (user_cost <= 0.0 || coarse_cost <= 0.0 || coarse_stats.check_stride <= 1)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Log lines that overflow the buffer force frames between the ticks. Only the
+    // rendering itself counts, so the fake clock sees none and the interval holds.
+    char line[200];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    config.clock_source = CPB_CLOCK_USER;
+    config.min_refresh_time = 0.25;
+    config.overhead_budget = 0.005;
+    cpb_init(&progress_bar, 0, 1000, config);
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= 1000; i++)
+    {
+        fake_time += 0.01;
+        cpb_log(&progress_bar, line);
+        cpb_update(&progress_bar, i);
+    }
+    CPB_Stats log_stats;
+    cpb_get_stats(&progress_bar, &log_stats);
+    cpb_finish(&progress_bar);
+
+    fprintf(
+        stderr,
+        "log overflow: renders=%lld render_ns_max=%lld refresh=%g s\n",
+        (long long)log_stats.renders,
+        (long long)log_stats.render_ns_max,
+        log_stats.effective_refresh_time
+    );
+    if (log_stats.renders <= 1000 / 25 || log_stats.render_ns_max != 0 ||
+        log_stats.effective_refresh_time != config.min_refresh_time)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c_progress_bar.h"
+
+#define N 1024
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+int main(void)
+{
+    double fake_time = 100.0;
+
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Fake clock";
+    config.min_refresh_time = 0.125;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    // Each item takes 1/64 s, so exactly one update in eight is rendered.
+    // Powers of two keep the fake time exact.
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= N; i++)
+    {
+        fake_time += 1.0 / 64.0;
+        cpb_update(&progress_bar, i);
+    }
+    cpb_finish(&progress_bar);
+
+    CPB_Stats stats;
+    cpb_get_stats(&progress_bar, &stats);
+    const double elapsed =
+        progress_bar.internal.timer_time_last_update - progress_bar.internal.time_start;
+    printf(
+        "\nelapsed=%f renders=%lld suppressed=%lld\n",
+        elapsed,
+        (long long)stats.renders,
+        (long long)stats.suppressed_updates
+    );
+
+    if (elapsed != N / 64.0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (stats.renders != N / 8 + 2 || stats.suppressed_updates != N - N / 8)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Every other clock source must work on any system through its fallback
+    const CPB_ClockSource sources[] = {
+        CPB_CLOCK_MONOTONIC, CPB_CLOCK_MONOTONIC_COARSE, CPB_CLOCK_TSC
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        config.clock_source = sources[i];
+        cpb_init(&progress_bar, 0, N, config);
+        cpb_start(&progress_bar);
+        if (progress_bar.internal.time_start <= 0.0)
+        {
+            return EXIT_FAILURE;
+        }
+        cpb_finish(&progress_bar);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(CPB_WATCH_PATH)
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif /* __linux__ && CPB_WATCH_PATH */
+
+#define SIZE (1 << 20)
+#define CHUNKS 64
+#define INPUT_FILE "test_cpb_watch.in"
+#define OUTPUT_FILE "test_cpb_watch.out"
+
+#if defined(__linux__) && defined(CPB_WATCH_PATH)
+// Reads the whole file in chunks and exits right after the last one, so the final
+// position is hardly ever sampled before the file is gone
+static void run_reader(int ready_fd)
+{
+    const int fd = open(INPUT_FILE, O_RDONLY);
+    if (fd < 0 || write(ready_fd, &fd, sizeof(fd)) != sizeof(fd))
+    {
+        _exit(EXIT_FAILURE);
+    }
+    close(ready_fd);
+
+    static char chunk[SIZE / CHUNKS];
+    const struct timespec pause = {0, 10000000};
+    for (int i = 0; i < CHUNKS; i++)
+    {
+        nanosleep(&pause, NULL);
+        if (read(fd, chunk, sizeof(chunk)) != (ssize_t)sizeof(chunk))
+        {
+            _exit(EXIT_FAILURE);
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+#endif /* __linux__ && CPB_WATCH_PATH */
+
+int main(void)
+{
+#if !defined(__linux__) || !defined(CPB_WATCH_PATH)
+    // cpb-watch is Linux only and built with BUILD_TOOLS
+    return EXIT_SUCCESS;
+#else
+    FILE *input = fopen(INPUT_FILE, "wb");
+    if (!input)
+    {
+        return EXIT_FAILURE;
+    }
+    static char data[SIZE];
+    memset(data, 'x', sizeof(data));
+    const size_t written = fwrite(data, 1, sizeof(data), input);
+    fclose(input);
+    if (written != sizeof(data))
+    {
+        return EXIT_FAILURE;
+    }
+
+    int ready_fds[2];
+    if (pipe(ready_fds) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    fflush(stdout);
+    const pid_t reader = fork();
+    if (reader == 0)
+    {
+        close(ready_fds[0]);
+        run_reader(ready_fds[1]);
+    }
+    close(ready_fds[1]);
+
+    // Attach once the reader has the file open
+    int fd = -1;
+    const ssize_t length = read(ready_fds[0], &fd, sizeof(fd));
+    close(ready_fds[0]);
+    if (reader < 0 || length != sizeof(fd))
+    {
+        return EXIT_FAILURE;
+    }
+
+    const pid_t watcher = fork();
+    if (watcher == 0)
+    {
+        const int output_fd = open(OUTPUT_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0 || dup2(output_fd, STDOUT_FILENO) < 0)
+        {
+            _exit(EXIT_FAILURE);
+        }
+        char pid_arg[16];
+        char fd_arg[16];
+        snprintf(pid_arg, sizeof(pid_arg), "%d", (int)reader);
+        snprintf(fd_arg, sizeof(fd_arg), "%d", fd);
+        execl(
+            CPB_WATCH_PATH,
+            "cpb-watch",
+            "-f",
+            fd_arg,
+            "-i",
+            "0.05",
+            pid_arg,
+            (char *)NULL
+        );
+        _exit(EXIT_FAILURE);
+    }
+
+    int watcher_status = -1;
+    int reader_status = -1;
+    if (watcher < 0 || waitpid(watcher, &watcher_status, 0) != watcher ||
+        waitpid(reader, &reader_status, 0) != reader)
+    {
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(OUTPUT_FILE, "r");
+    if (!file)
+    {
+        return EXIT_FAILURE;
+    }
+    static char output[1 << 16];
+    const size_t output_length = fread(output, 1, sizeof(output) - 1, file);
+    output[output_length] = '\0';
+    fclose(file);
+    remove(OUTPUT_FILE);
+    remove(INPUT_FILE);
+
+    const char *last_frame = strrchr(output, '\r');
+    fprintf(stderr, "%s", last_frame ? last_frame + 1 : output);
+
+    // A reader that got to the end is a normal completion, sampled there or not
+    if (!WIFEXITED(reader_status) || WEXITSTATUS(reader_status) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (!WIFEXITED(watcher_status) || WEXITSTATUS(watcher_status) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (!last_frame || !strstr(last_frame, "100%"))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+#endif /* __linux__ && CPB_WATCH_PATH */
+}
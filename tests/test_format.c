@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_progress_bar.h"
+
+#define N 64
+#define OUTPUT_FILE "test_format.out"
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+int main(void)
+{
+    double fake_time = 100.0;
+
+    // Capture the rendered frames. The output is not a terminal, so plain ASCII.
+    if (!freopen(OUTPUT_FILE, "w", stdout))
+    {
+        return EXIT_FAILURE;
+    }
+
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Format";
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    config.format = "{desc}|{bar:8}|{pct}|{[p50 {p50}]}|{rate}|{typo}|{{x}}";
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= N; i++)
+    {
+        fake_time += 1.0 / 64.0;
+        cpb_update(&progress_bar, i);
+    }
+    cpb_finish(&progress_bar);
+    fflush(stdout);
+
+    FILE *file = fopen(OUTPUT_FILE, "r");
+    if (!file)
+    {
+        return EXIT_FAILURE;
+    }
+    char output[4096];
+    const size_t length = fread(output, 1, sizeof(output) - 1, file);
+    output[length] = '\0';
+    fclose(file);
+    remove(OUTPUT_FILE);
+
+    // No latency was recorded, so the p50 group is dropped
+    const char *expected = "\rFormat|[========]|100%||64.00/s|{typo}|{x}\n";
+    const char *last_frame = strrchr(output, '\r');
+    fprintf(stderr, "%s", last_frame ? last_frame + 1 : output);
+    if (!last_frame || strcmp(last_frame, expected) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c_progress_bar.h"
+
+#define INITIAL_TOTAL 1024
+#define DISCOVERED_PER_STEP 6400
+#define DONE_PER_STEP 64
+#define STEPS_PER_SECOND 16
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+int main(void)
+{
+    double fake_time = 100.0;
+
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Growth";
+    config.min_refresh_time = 0.5;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    config.headless = true;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, INITIAL_TOTAL, config);
+
+    // About a million items are discovered during the first 10 s, while 1024 items/s
+    // are done from the start. Powers of two keep the fake time exact.
+    cpb_start(&progress_bar);
+    int64_t current = 0;
+    CPB_Snapshot snapshot;
+    for (int step = 1; step <= 800 * STEPS_PER_SECOND; step++)
+    {
+        fake_time += 1.0 / STEPS_PER_SECOND;
+        if (step <= 10 * STEPS_PER_SECOND)
+        {
+            cpb_add_total(&progress_bar, DISCOVERED_PER_STEP);
+        }
+        current += DONE_PER_STEP;
+        cpb_update(&progress_bar, current);
+
+        cpb_snapshot(&progress_bar, &snapshot);
+        const double elapsed = (double)step / STEPS_PER_SECOND;
+        const double done_rate = DONE_PER_STEP * STEPS_PER_SECOND;
+        const double expected = (double)(snapshot.total - snapshot.current) / done_rate;
+
+        // Unknown while work is discovered faster than it is done
+        if (elapsed > 1.0 && elapsed <= 10.0 && snapshot.remaining_time >= 0.0)
+        {
+            fprintf(stderr, "t=%g: eta=%g\n", elapsed, snapshot.remaining_time);
+            return EXIT_FAILURE;
+        }
+
+        // Back to the plain estimate once the discovery is out of the recent ticks
+        if (elapsed >= 20.0 &&
+            (snapshot.remaining_time < expected * 0.99 ||
+             snapshot.remaining_time > expected * 1.01))
+        {
+            fprintf(
+                stderr,
+                "t=%g: eta=%g, expected %g\n",
+                elapsed,
+                snapshot.remaining_time,
+                expected
+            );
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf(
+        "%lld of %lld, eta=%g\n",
+        (long long)snapshot.current,
+        (long long)snapshot.total,
+        snapshot.remaining_time
+    );
+    cpb_finish(&progress_bar);
+
+    return EXIT_SUCCESS;
+}
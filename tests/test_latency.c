@@ -0,0 +1,54 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c_progress_bar.h"
+
+#define N 10000
+
+static int is_close(double value, double expected)
+{
+    // Buckets are at most 1/16 wide relative to their value
+    return value >= expected * 0.93 && value <= expected * 1.07;
+}
+
+int main(void)
+{
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Latency";
+    config.show_latency = true;
+    config.dump_latency_histogram = true;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    // 98% of the items take 1 ms, 2% take 50 ms
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= N; i++)
+    {
+        const double item_time = (i % 50 == 0) ? 50e-3 : 1e-3;
+        cpb_update_timed(&progress_bar, i, item_time);
+    }
+    cpb_finish(&progress_bar);
+
+    const double p50 = cpb_get_latency_percentile(&progress_bar, 50.0);
+    const double p99 = cpb_get_latency_percentile(&progress_bar, 99.0);
+    const double p100 = cpb_get_latency_percentile(&progress_bar, 100.0);
+    printf("p50=%g p99=%g p100=%g\n", p50, p99, p100);
+
+    if (!is_close(p50, 1e-3) || !is_close(p99, 50e-3) || p100 != 50e-3)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // NaN is ignored, and huge durations land in the last bucket
+    cpb_record_latency(&progress_bar, NAN);
+    cpb_record_latency(&progress_bar, 1e30);
+    if (progress_bar.internal.latency_count != N + 1 ||
+        progress_bar.internal.latency_buckets[CPB_LATENCY_BUCKETS - 1] != 1)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
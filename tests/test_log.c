@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_progress_bar.h"
+
+#define N 1024
+#define OUTPUT_FILE "test_log.out"
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+int main(void)
+{
+    double fake_time = 100.0;
+
+    if (!freopen(OUTPUT_FILE, "w", stdout))
+    {
+        return EXIT_FAILURE;
+    }
+
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Log";
+    config.min_refresh_time = 0.125;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    // Log on every other update, while only one update in eight is rendered
+    cpb_log(&progress_bar, "before start");
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= N; i++)
+    {
+        fake_time += 1.0 / 64.0;
+        if (i % 2 == 0)
+        {
+            cpb_printf(&progress_bar, "item %lld\n", (long long)i);
+        }
+        cpb_update(&progress_bar, i);
+    }
+    cpb_finish(&progress_bar);
+    cpb_log(&progress_bar, "after finish");
+    fflush(stdout);
+
+    CPB_Stats stats;
+    cpb_get_stats(&progress_bar, &stats);
+
+    FILE *file = fopen(OUTPUT_FILE, "r");
+    if (!file)
+    {
+        return EXIT_FAILURE;
+    }
+    static char output[1 << 20];
+    const size_t length = fread(output, 1, sizeof(output) - 1, file);
+    output[length] = '\0';
+    fclose(file);
+    remove(OUTPUT_FILE);
+
+    // Every line is written exactly once and in order
+    int lines = 0;
+    const char *p = output;
+    while ((p = strstr(p, "item ")) != NULL)
+    {
+        lines++;
+        if (atoll(p + 5) != 2 * lines)
+        {
+            return EXIT_FAILURE;
+        }
+        p++;
+    }
+
+    fprintf(
+        stderr,
+        "renders=%lld log_lines=%lld lines=%d\n",
+        (long long)stats.renders,
+        (long long)stats.log_lines,
+        lines
+    );
+    if (lines != N / 2 || stats.log_lines != N / 2 || stats.renders != N / 8 + 2)
+    {
+        return EXIT_FAILURE;
+    }
+    if (strncmp(output, "before start\n", 13) != 0 ||
+        strcmp(output + length - 13, "after finish\n") != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
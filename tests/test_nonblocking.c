@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include "c_progress_bar.h"
+
+#define N 16384
+
+#ifdef __linux__
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+static size_t read_available(int fd, char *buffer, size_t size)
+{
+    size_t length = 0;
+    ssize_t result;
+    while (length < size && (result = read(fd, buffer + length, size - length)) > 0)
+    {
+        length += (size_t)result;
+    }
+    return length;
+}
+#endif /* __linux__ */
+
+int main(void)
+{
+#ifndef __linux__
+    // Pipes are only reopened as non-blocking through /proc
+    return EXIT_SUCCESS;
+#else
+    double fake_time = 100.0;
+
+    // Nothing reads the pipe during the run, so it fills up
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0 || dup2(pipe_fds[1], STDOUT_FILENO) < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    close(pipe_fds[1]);
+
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Non-blocking";
+    config.min_refresh_time = 0.125;
+    config.nonblocking_output = true;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    cpb_start(&progress_bar);
+    if (!progress_bar.internal._output)
+    {
+        return EXIT_FAILURE;
+    }
+    for (int64_t i = 1; i <= N; i++)
+    {
+        fake_time += 1.0 / 64.0;
+        if (i % 4 == 0)
+        {
+            cpb_printf(&progress_bar, "item %lld\n", (long long)i);
+        }
+        cpb_update(&progress_bar, i);
+    }
+
+    // Make room for the final frame, which cpb_finish waits for
+    static char output[1 << 20];
+    fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+    size_t length = read_available(pipe_fds[0], output, sizeof(output) - 1);
+    cpb_finish(&progress_bar);
+    length += read_available(pipe_fds[0], output + length, sizeof(output) - 1 - length);
+    output[length] = '\0';
+    close(pipe_fds[0]);
+
+    CPB_Stats stats;
+    cpb_get_stats(&progress_bar, &stats);
+    const char *last_frame = strrchr(output, '\r');
+
+    // Log lines are dropped rather than waited for, and the others arrive in order
+    int64_t lines = 0;
+    int64_t last_item = 0;
+    const char *p = output;
+    while ((p = strstr(p, "item ")) != NULL)
+    {
+        const int64_t item = atoll(p + 5);
+        if (item <= last_item)
+        {
+            return EXIT_FAILURE;
+        }
+        last_item = item;
+        lines++;
+        p++;
+    }
+
+    fprintf(
+        stderr,
+        "renders=%lld frames_dropped=%lld bytes=%zu lines=%lld/%lld dropped=%lld\n",
+        (long long)stats.renders,
+        (long long)stats.frames_dropped,
+        length,
+        (long long)lines,
+        (long long)stats.log_lines,
+        (long long)stats.log_lines_dropped
+    );
+
+    if (stats.frames_dropped <= 0 || progress_bar.internal._output)
+    {
+        return EXIT_FAILURE;
+    }
+    if (stats.log_lines_dropped <= 0 || lines != stats.log_lines ||
+        stats.log_lines + stats.log_lines_dropped != N / 4)
+    {
+        return EXIT_FAILURE;
+    }
+    if (!last_frame || !strstr(last_frame, "100%") || output[length - 1] != '\n')
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+#endif /* __linux__ */
+}
@@ -0,0 +1,67 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "c_progress_bar.h"
+
+#define N 200
+#define LAG 20
+
+static void busy_wait(double seconds)
+{
+    const clock_t start = clock();
+    while ((double)(clock() - start) / CLOCKS_PER_SEC < seconds)
+    {
+    }
+}
+
+int main(void)
+{
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Pipeline";
+    CPB_Pipeline pipeline;
+    cpb_pipeline_init(&pipeline, N, config);
+    const int extract = cpb_pipeline_add_stage(&pipeline, "extract");
+    const int transform = cpb_pipeline_add_stage(&pipeline, "transform");
+    const int load = cpb_pipeline_add_stage(&pipeline, "load");
+
+    // Everything is extracted right away, then transform holds the rest back. Load
+    // trails it by a few items, so it is always the stage with the fewest done.
+    cpb_pipeline_start(&pipeline);
+    cpb_pipeline_update(&pipeline, extract, N);
+    for (int64_t i = 1; i <= N + LAG; i++)
+    {
+        busy_wait(0.005);
+        if (i <= N)
+        {
+            cpb_pipeline_set_queue_depth(&pipeline, transform, N - i);
+            cpb_pipeline_add(&pipeline, transform, 1);
+        }
+        if (i > LAG)
+        {
+            cpb_pipeline_update(&pipeline, load, i - LAG);
+        }
+    }
+    cpb_pipeline_finish(&pipeline);
+
+    printf(
+        "rates: %g %g %g, bottleneck %d\n",
+        pipeline.stages[extract].rate,
+        pipeline.stages[transform].rate,
+        pipeline.stages[load].rate,
+        pipeline.internal.bottleneck
+    );
+
+    if (pipeline.progress_bar.current != N || pipeline.stages[transform].count != N)
+    {
+        return EXIT_FAILURE;
+    }
+    if (pipeline.internal.bottleneck != transform ||
+        pipeline.stages[extract].rate <= pipeline.stages[transform].rate)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include "c_progress_bar.h"
+
+#define SIZE 4096
+#define POSITION 1000
+
+int main(void)
+{
+#ifndef __linux__
+    // Process sources read /proc, so they are Linux only
+    return EXIT_SUCCESS;
+#else
+    FILE *file = tmpfile();
+    if (!file)
+    {
+        return EXIT_FAILURE;
+    }
+    char data[SIZE];
+    memset(data, 'x', sizeof(data));
+    if (fwrite(data, 1, sizeof(data), file) != sizeof(data) ||
+        fseek(file, POSITION, SEEK_SET) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    const int fd = fileno(file);
+
+    // Watch this very process, through the position of its temporary file
+    CPB_ProcessSource source;
+    int64_t current = -1;
+    if (!cpb_process_source_init(&source, (int)getpid(), fd, CPB_PROCESS_FD_POSITION) ||
+        !cpb_process_source_sample(&source, &current))
+    {
+        return EXIT_FAILURE;
+    }
+    fprintf(
+        stderr,
+        "fd %d: %lld of %lld (%s)\n",
+        source.fd,
+        (long long)current,
+        (long long)source.total,
+        source.name
+    );
+    if (source.fd != fd || source.total != SIZE || current != POSITION)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // The I/O counters have no total, but include what was written above
+    CPB_ProcessSource io_source;
+    int64_t written = -1;
+    if (!cpb_process_source_init(
+            &io_source, (int)getpid(), -1, CPB_PROCESS_WRITE_BYTES
+        ) ||
+        !cpb_process_source_sample(&io_source, &written))
+    {
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%s wrote %lld bytes\n", io_source.name, (long long)written);
+    if (io_source.total != 0 || written < SIZE)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Once the file is closed, sampling fails and keeps the last value
+    fclose(file);
+    if (cpb_process_source_sample(&source, &current) || current != POSITION)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+#endif /* __linux__ */
+}
@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "c_progress_bar.h"
+
+#define N 50
+
+static void busy_wait(double seconds)
+{
+    const clock_t start = clock();
+    while ((double)(clock() - start) / CLOCKS_PER_SEC < seconds)
+    {
+    }
+}
+
+int main(void)
+{
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Resources";
+    config.min_refresh_time = 0.05;
+    config.show_resources = true;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    // Not shown by the format, so never sampled
+    config.show_resources = false;
+    CPB_ProgressBar hidden_bar;
+    cpb_init(&hidden_bar, 0, N, config);
+
+    cpb_start(&progress_bar);
+    cpb_start(&hidden_bar);
+    for (int64_t i = 1; i <= N; i++)
+    {
+        busy_wait(0.01);
+        cpb_update(&progress_bar, i);
+        cpb_update(&hidden_bar, i);
+    }
+    cpb_finish(&progress_bar);
+    cpb_finish(&hidden_bar);
+
+    printf(
+        "cpu=%.0f%% rss=%lld read=%.0f/s write=%.0f/s\n",
+        progress_bar.internal.cpu_percent,
+        (long long)progress_bar.internal.rss_bytes,
+        progress_bar.internal.read_bytes_rate,
+        progress_bar.internal.write_bytes_rate
+    );
+
+    // The final frame comes right after the last tick, and keeps what it sampled
+    if (progress_bar.internal.cpu_percent < 0.0 ||
+        hidden_bar.internal.cpu_percent >= 0.0)
+    {
+        return EXIT_FAILURE;
+    }
+#ifdef __linux__
+    // Busy waiting does no I/O, and the frames and /proc reads of the bar are not
+    // counted as such
+    if (progress_bar.internal.cpu_percent <= 0.0 ||
+        progress_bar.internal.rss_bytes <= 0 ||
+        progress_bar.internal.read_bytes_rate < 0.0 ||
+        progress_bar.internal.read_bytes_rate > 1024.0 ||
+        progress_bar.internal.write_bytes_rate < 0.0 ||
+        progress_bar.internal.write_bytes_rate > 1024.0)
+    {
+        return EXIT_FAILURE;
+    }
+#endif /* __linux__ */
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif /* _WIN32 */
+
+#include "c_progress_bar.h"
+
+#define N 1024
+#define OUTPUT_FILE "test_snapshot.out"
+
+typedef struct
+{
+    const CPB_ProgressBar *progress_bar;
+    int64_t snapshots;
+    bool is_consistent;
+} Reader;
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+// Every snapshot must come from a single refresh tick, and ticks only move forward.
+// The final one shows 100% whatever the position, like the final frame.
+static void read_snapshots(Reader *reader)
+{
+    CPB_Snapshot previous = {0};
+    CPB_Snapshot snapshot;
+    do
+    {
+        cpb_snapshot(reader->progress_bar, &snapshot);
+        reader->snapshots++;
+
+        const double percentage =
+            snapshot.current >= snapshot.total
+                ? 100.0
+                : ((double)snapshot.current / (double)snapshot.total) * 100.0;
+        if (snapshot.current > snapshot.total ||
+            (snapshot.current > 0 && !snapshot.is_finished &&
+             snapshot.percentage != percentage) ||
+            snapshot.current < previous.current ||
+            snapshot.total < previous.total ||
+            snapshot.elapsed_time < previous.elapsed_time)
+        {
+            reader->is_consistent = false;
+        }
+        previous = snapshot;
+    } while (!snapshot.is_finished);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI reader_main(LPVOID arg)
+{
+    read_snapshots(arg);
+    return 0;
+}
+#else
+static void *reader_main(void *arg)
+{
+    read_snapshots(arg);
+    return NULL;
+}
+#endif /* _WIN32 */
+
+int main(void)
+{
+    double fake_time = 100.0;
+
+    // Headless bars must not write anything
+    if (!freopen(OUTPUT_FILE, "w", stdout))
+    {
+        return EXIT_FAILURE;
+    }
+
+    CPB_Config config = cpb_get_default_config();
+    config.min_refresh_time = 0.125;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    config.headless = true;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    CPB_Snapshot snapshot;
+    cpb_snapshot(&progress_bar, &snapshot);
+    if (snapshot.is_started || snapshot.total != N)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // 64 items per second, so the snapshot is exact at every refresh tick
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= N / 2; i++)
+    {
+        fake_time += 1.0 / 64.0;
+        cpb_update(&progress_bar, i);
+    }
+    cpb_snapshot(&progress_bar, &snapshot);
+    fprintf(
+        stderr,
+        "current=%lld pct=%g elapsed=%g eta=%g rate=%g overall=%g\n",
+        (long long)snapshot.current,
+        snapshot.percentage,
+        snapshot.elapsed_time,
+        snapshot.remaining_time,
+        snapshot.rate,
+        snapshot.overall_rate
+    );
+    if (!snapshot.is_started || snapshot.is_finished || snapshot.current != N / 2 ||
+        snapshot.percentage != 50.0 || snapshot.elapsed_time != N / 128.0 ||
+        snapshot.overall_rate != 64.0 || snapshot.rate != 64.0 ||
+        snapshot.remaining_time != N / 128.0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    cpb_finish(&progress_bar);
+    cpb_snapshot(&progress_bar, &snapshot);
+    if (!snapshot.is_finished || snapshot.remaining_time != 0.0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Refresh ticks still run, including the start and finish ones, but write nothing
+    CPB_Stats stats;
+    cpb_get_stats(&progress_bar, &stats);
+    if (stats.renders != N / 16 + 2 || stats.bytes_written != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    fflush(stdout);
+    FILE *file = fopen(OUTPUT_FILE, "r");
+    if (!file)
+    {
+        return EXIT_FAILURE;
+    }
+    const int c = fgetc(file);
+    fclose(file);
+    remove(OUTPUT_FILE);
+    if (c != EOF)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Read snapshots from another thread while every update is a refresh tick, and
+    // the total grows along with the progress
+    config = cpb_get_default_config();
+    config.min_refresh_time = 0.0;
+    config.headless = true;
+    cpb_init(&progress_bar, 0, 2, config);
+    Reader reader = {&progress_bar, 0, true};
+#ifdef _WIN32
+    HANDLE thread = CreateThread(NULL, 0, reader_main, &reader, 0, NULL);
+    if (!thread)
+    {
+        return EXIT_FAILURE;
+    }
+#else
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, reader_main, &reader) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+#endif /* _WIN32 */
+
+    cpb_start(&progress_bar);
+    int64_t current = 0;
+    const clock_t end = clock() + CLOCKS_PER_SEC / 4;
+    while (clock() < end)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            cpb_add_total(&progress_bar, 2);
+            cpb_update(&progress_bar, ++current);
+        }
+    }
+    cpb_finish(&progress_bar);
+
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif /* _WIN32 */
+
+    fprintf(
+        stderr,
+        "updates=%lld snapshots=%lld consistent=%d\n",
+        (long long)current,
+        (long long)reader.snapshots,
+        reader.is_consistent
+    );
+    if (!reader.is_consistent || reader.snapshots < 2)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
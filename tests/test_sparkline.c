@@ -0,0 +1,79 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c_progress_bar.h"
+
+#define N 1024
+#define OUTPUT_FILE "test_sparkline.out"
+
+static double fake_clock(void *user_data)
+{
+    return *(const double *)user_data;
+}
+
+int main(void)
+{
+    double fake_time = 100.0;
+
+    // Capture the rendered frames. The output is not a terminal, so plain ASCII.
+    if (!freopen(OUTPUT_FILE, "w", stdout))
+    {
+        return EXIT_FAILURE;
+    }
+
+    CPB_Config config = cpb_get_default_config();
+    config.min_refresh_time = 0.125;
+    config.clock_source = CPB_CLOCK_USER;
+    config.clock_function = fake_clock;
+    config.clock_user_data = &fake_time;
+    config.format = "{spark}";
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    // 64 items/s for the first 8 s, then 16 items/s for the remaining 32 s.
+    // Powers of two keep the fake time exact.
+    cpb_start(&progress_bar);
+    for (int64_t i = 1; i <= N; i++)
+    {
+        fake_time += i <= N / 2 ? 1.0 / 64.0 : 1.0 / 16.0;
+        cpb_update(&progress_bar, i);
+    }
+    cpb_finish(&progress_bar);
+    fflush(stdout);
+
+    FILE *file = fopen(OUTPUT_FILE, "r");
+    if (!file)
+    {
+        return EXIT_FAILURE;
+    }
+    static char output[1 << 16];
+    const size_t length = fread(output, 1, sizeof(output) - 1, file);
+    output[length] = '\0';
+    fclose(file);
+    remove(OUTPUT_FILE);
+
+    // 320 ticks of 1/8 s were downsampled into 4 s points: full height while fast,
+    // a quarter of it afterwards, and in between for the point spanning the change
+    const char *expected = "\r##-,,,,,,,\n";
+    const char *last_frame = strrchr(output, '\r');
+    fprintf(
+        stderr,
+        "%s(%d points of %g s)\n",
+        last_frame ? last_frame + 1 : output,
+        progress_bar.internal.rate_history_count,
+        progress_bar.internal.rate_history_span
+    );
+    if (!last_frame || strcmp(last_frame, expected) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (progress_bar.internal.rate_history_count > CPB_RATE_HISTORY_POINTS ||
+        progress_bar.internal.rate_history_span != 4.0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
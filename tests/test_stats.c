@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "c_progress_bar.h"
+
+#define N 100000
+
+int main(void)
+{
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Stats";
+    config.min_refresh_time = 1e9;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    cpb_start(&progress_bar);
+    for (int64_t i = 0; i <= N; i++)
+    {
+        cpb_update(&progress_bar, i);
+    }
+    cpb_finish(&progress_bar);
+
+    CPB_Stats stats;
+    cpb_get_stats(&progress_bar, &stats);
+    printf(
+        "updates=%lld clock_reads=%lld suppressed=%lld renders=%lld "
+        "render_ns_total=%lld render_ns_max=%lld bytes=%lld\n",
+        (long long)stats.updates,
+        (long long)stats.clock_reads,
+        (long long)stats.suppressed_updates,
+        (long long)stats.renders,
+        (long long)stats.render_ns_total,
+        (long long)stats.render_ns_max,
+        (long long)stats.bytes_written
+    );
+
+    // Only the first and the final frame are rendered
+    if (stats.updates != N + 1 || stats.suppressed_updates != N + 1 ||
+        stats.renders != 2)
+    {
+        return EXIT_FAILURE;
+    }
+    if (stats.clock_reads < stats.updates || stats.bytes_written <= 0 ||
+        stats.render_ns_max > stats.render_ns_total)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
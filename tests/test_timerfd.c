@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include "c_progress_bar.h"
+
+#define N 200
+
+#ifdef __linux__
+static void busy_wait(double seconds)
+{
+    const clock_t start = clock();
+    while ((double)(clock() - start) / CLOCKS_PER_SEC < seconds)
+    {
+    }
+}
+
+// Returns the number of timer expirations handled
+static int poll_events(int epoll_fd, CPB_ProgressBar *progress_bar, int timeout_ms)
+{
+    struct epoll_event event;
+    const int ready = epoll_wait(epoll_fd, &event, 1, timeout_ms);
+    if (ready == 1 && event.data.ptr == progress_bar)
+    {
+        cpb_on_timer(progress_bar);
+    }
+    return ready > 0 ? ready : 0;
+}
+#endif /* __linux__ */
+
+int main(void)
+{
+#ifndef __linux__
+    // timerfd is Linux only
+    return EXIT_SUCCESS;
+#else
+    CPB_Config config = cpb_get_default_config();
+    config.description = "Timer fd";
+    config.min_refresh_time = 0.02;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, N, config);
+
+    cpb_start(&progress_bar);
+    const int timer_fd = cpb_get_timer_fd(&progress_bar);
+    const int epoll_fd = epoll_create1(0);
+    if (timer_fd < 0 || epoll_fd < 0)
+    {
+        return EXIT_FAILURE;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = &progress_bar};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    int expirations = 0;
+    for (int64_t i = 1; i <= N; i++)
+    {
+        busy_wait(0.001);
+        cpb_update(&progress_bar, i);
+        expirations += poll_events(epoll_fd, &progress_bar, 0);
+    }
+
+    // Once the last update is shown, the timer keeps firing without rendering
+    poll_events(epoll_fd, &progress_bar, 1000);
+    CPB_Stats stats;
+    cpb_get_stats(&progress_bar, &stats);
+    const int64_t renders = stats.renders;
+    for (int i = 0; i < 3; i++)
+    {
+        poll_events(epoll_fd, &progress_bar, 1000);
+    }
+    cpb_get_stats(&progress_bar, &stats);
+    const int64_t idle_renders = stats.renders - renders;
+
+    close(epoll_fd);
+    cpb_finish(&progress_bar);
+    cpb_get_stats(&progress_bar, &stats);
+
+    fprintf(
+        stderr,
+        "expirations=%d renders=%lld idle_renders=%lld clock_reads=%lld\n",
+        expirations,
+        (long long)stats.renders,
+        (long long)idle_renders,
+        (long long)stats.clock_reads
+    );
+
+    // cpb_update never reads the clock, only the timer ticks and finish do
+    if (expirations < 2 || renders < 2 || idle_renders != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    if (stats.updates != N || stats.clock_reads > 2 * stats.renders + 2)
+    {
+        return EXIT_FAILURE;
+    }
+    if (progress_bar.internal._timer_fd >= 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+#endif /* __linux__ */
+}
@@ -0,0 +1,132 @@
+/**
+ * \file cpb_watch.c
+ * \brief Show the progress of another process, similar to `pv -d`.
+ *
+ * Usage: cpb-watch [-f fd] [-r | -w] [-s size] [-i interval] pid
+ *
+ * \author Ching-Yin Ng
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "c_progress_bar.h"
+
+static void print_usage(const char *program)
+{
+    fprintf(
+        stderr,
+        "Usage: %s [-f fd] [-r | -w] [-s size] [-i interval] pid\n"
+        "  -f fd        File descriptor to watch (default: largest open file)\n"
+        "  -r           Use the bytes read by the process (/proc/<pid>/io)\n"
+        "  -w           Use the bytes written by the process (/proc/<pid>/io)\n"
+        "  -s size      Total bytes, required with -r and -w\n"
+        "  -i interval  Sampling interval in seconds (default: 0.5)\n",
+        program
+    );
+}
+
+static void sleep_seconds(double seconds)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    int pid = -1;
+    int fd = -1;
+    CPB_ProcessCounter counter = CPB_PROCESS_FD_POSITION;
+    int64_t total = 0;
+    double interval = 0.5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-f") == 0 && has_value)
+        {
+            fd = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            counter = CPB_PROCESS_READ_BYTES;
+        }
+        else if (strcmp(argv[i], "-w") == 0)
+        {
+            counter = CPB_PROCESS_WRITE_BYTES;
+        }
+        else if (strcmp(argv[i], "-s") == 0 && has_value)
+        {
+            total = (int64_t)strtoll(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-i") == 0 && has_value)
+        {
+            interval = atof(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && pid < 0)
+        {
+            pid = atoi(argv[i]);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (pid <= 0 || interval <= 0.0)
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    CPB_ProcessSource source;
+    if (!cpb_process_source_init(&source, pid, fd, counter))
+    {
+        fprintf(stderr, "cpb-watch: cannot watch process %d\n", pid);
+        return EXIT_FAILURE;
+    }
+    if (total <= 0)
+    {
+        total = source.total;
+    }
+    if (total <= 0)
+    {
+        fprintf(stderr, "cpb-watch: total size unknown, use -s\n");
+        return EXIT_FAILURE;
+    }
+
+    int64_t current = 0;
+    if (!cpb_process_source_sample(&source, &current))
+    {
+        fprintf(stderr, "cpb-watch: cannot sample process %d\n", pid);
+        return EXIT_FAILURE;
+    }
+
+    // Progress made before attaching is shown, but not counted towards the rate
+    CPB_Config config = cpb_get_default_config();
+    config.description = source.name;
+    config.min_refresh_time = interval;
+    CPB_ProgressBar progress_bar;
+    cpb_init(&progress_bar, 0, total, config);
+    progress_bar.current = current;
+
+    cpb_start(&progress_bar);
+    while (cpb_process_source_sample(&source, &current))
+    {
+        cpb_update(&progress_bar, current);
+        sleep_seconds(interval);
+    }
+
+    // The process closed the file or exited. It is rarely sampled right at the end
+    // before that, and how it ended cannot be told from here, so finish like pv -d.
+    cpb_finish(&progress_bar);
+
+    return EXIT_SUCCESS;
+}